@@ -0,0 +1,18 @@
+#ifndef CACHE_CHEMINS_H
+#define CACHE_CHEMINS_H
+
+#include "structures.h"
+
+// Cache des résolutions de chemins de répertoires (chemin interne -> inode), valable pour la session
+#define DENTRY_CACHE_SIZE 256
+
+// Inode d'un répertoire déjà résolu, ou -1 si le chemin n'est pas en cache
+int32_t dentry_cache_lookup(uint8_t *map, const char *path);
+// Mémorise la résolution d'un chemin de répertoire
+void dentry_cache_insert(const char *path, int32_t inode);
+// Oublie un chemin et tout ce qui se trouve en dessous (à appeler après une modification de l'arborescence)
+void dentry_cache_invalidate(const char *path);
+// Vide le cache (fin de session)
+void dentry_cache_clear(void);
+
+#endif
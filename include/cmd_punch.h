@@ -0,0 +1,8 @@
+#ifndef CMD_PUNCH_H
+#define CMD_PUNCH_H
+
+#include <stdint.h>
+
+int cmd_punch(const char *fsname, const char *filename, uint64_t offset, uint64_t length);
+
+#endif
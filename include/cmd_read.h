@@ -0,0 +1,8 @@
+#ifndef CMD_READ_H
+#define CMD_READ_H
+
+#include <stdint.h>
+
+int cmd_read(const char *fsname, const char *filename, uint64_t offset, uint64_t length);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef CMD_WRITE_H
+#define CMD_WRITE_H
+
+#include <stdint.h>
+
+int cmd_write(const char *fsname, const char *filename, uint64_t offset);
+
+#endif
@@ -18,9 +18,12 @@
 #include "../include/cmd_mkfs.h"
 #include "../include/cmd_mkdir.h"
 #include "../include/cmd_mv.h"
+#include "../include/cmd_punch.h"
+#include "../include/cmd_read.h"
 #include "../include/cmd_rm.h"
 #include "../include/cmd_rmdir.h"
 #include "../include/cmd_tree.h"
+#include "../include/cmd_write.h"
 
 void print_usage();
 int commands(int argc, char *argv[]);
@@ -0,0 +1,23 @@
+#ifndef INDEX_DOSSIER_H
+#define INDEX_DOSSIER_H
+
+#include "structures.h"
+
+// Index persistant des noms d'un répertoire (nom -> inode), créé à partir de DIR_INDEX_MIN entrées
+#define DIR_INDEX_MIN 16
+// Jusqu'à DIR_INDEX_DIRECT blocs de cases, l'en-tête les liste directement ; au-delà, il liste des pages
+// d'adresses (type 6) de 1000 blocs de cases chacune
+#define DIR_INDEX_DIRECT 997
+// Taille maximale : un répertoire plein (DIR_MAX_ENTRIES entrées) reste rempli au quart
+#define DIR_INDEX_MAX_BLOCKS 4004
+
+// Recherche d'un enfant par nom et type ; -1 s'il n'existe pas, -2 si le répertoire n'a pas d'index
+int32_t dir_index_lookup(uint8_t *map, struct inode *dir, const char *name, bool type);
+// Ajout d'un enfant déjà présent dans le répertoire (crée ou agrandit l'index si besoin)
+void dir_index_insert(uint8_t *map, struct inode *dir, int32_t child);
+// Retrait d'un enfant, à faire avant de changer son nom
+void dir_index_remove(uint8_t *map, struct inode *dir, int32_t child);
+// Libère les blocs de l'index d'un répertoire
+void dir_index_free(uint8_t *map, struct inode *dir);
+
+#endif
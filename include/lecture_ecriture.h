@@ -0,0 +1,20 @@
+#ifndef LECTURE_ECRITURE_H
+#define LECTURE_ECRITURE_H
+
+#include "structures.h"
+#include "utilitaires.h"
+
+// Taille maximale d'un fichier (environ 4 Po avec l'indirection triple)
+#define PFS_MAX_FILE_SIZE ((uint64_t)FILE_MAX_BLOCKS * 4000)
+
+// Lecture de len octets à partir de offset (bornée par la fin du fichier) ; renvoie le nombre d'octets lus
+ssize_t pfs_pread(uint8_t *map, struct inode *in, void *buf, size_t len, uint64_t offset);
+// Écriture de len octets à partir de offset, sans tronquer le fichier. Au-delà de la fin, l'écart
+// devient un trou (aucun bloc alloué, lu comme des zéros). Renvoie le nombre d'octets écrits
+// (moins que len si le conteneur est plein), -1 en cas d'erreur
+ssize_t pfs_pwrite(uint8_t *map, struct inode *in, const void *buf, size_t len, uint64_t offset);
+// Perce un trou sur [offset, offset + len) sans changer la taille : les blocs entièrement couverts
+// (et les blocs d'adresses devenus vides) sont libérés, les bords sont remis à zéro
+int pfs_punch(uint8_t *map, struct inode *in, uint64_t offset, uint64_t len);
+
+#endif
@@ -6,31 +6,23 @@
 #include <openssl/sha.h>
 #include <openssl/evp.h>
 #include <string.h>
+#include <stdbool.h>
 
 // Calcul SHA1 d'un bloc de données
 void calcul_sha1(const void *data, size_t len, uint8_t *out);
+// Calcul SHA1 par lot de n blocs de même taille : out[i] reçoit le SHA1 de data[i]
+void calcul_sha1_many(const void *const data[], int n, size_t len, uint8_t *const out[]);
 
-void check_sha1(const void *data, size_t len, uint8_t *out);
+// Noyaux de calcul SHA1 (sha1_mb.c) : OpenSSL ou noyaux internes SIMD
+enum sha1_kernel {SHA1_KERNEL_OPENSSL, SHA1_KERNEL_SSE2, SHA1_KERNEL_AVX2, SHA1_KERNEL_SHANI};
+bool sha1_kernel_supported(enum sha1_kernel kernel);
+enum sha1_kernel sha1_best_kernel(void);
+bool sha1_kernel_many(enum sha1_kernel kernel, const void *const data[], int n, size_t len, uint8_t *const out[]);
+// Force un noyau (tests, comparaison), retourne false s'il n'est pas supporté par le CPU
+bool set_sha1_kernel(enum sha1_kernel kernel);
 
-typedef struct {
-  void *data;
-  size_t len;
-  uint8_t sha1_ref[20];
-  int block_num;
-  int block_type;
-} sha1_task_t;
+// Vérifie un SHA1 de référence, retourne false (et affiche les deux) s'il ne correspond pas
+bool check_sha1(const void *data, size_t len, const uint8_t *out);
 
-#define SHA1_QUEUE_SIZE 256
-typedef struct {
-  sha1_task_t tasks[SHA1_QUEUE_SIZE];
-  int head, tail;
-  pthread_mutex_t mutex;
-  pthread_cond_t cond;
-  int done; // Pour signaler la fin
-} sha1_queue_t;
-
-extern sha1_queue_t sha1_queue;
-
-void *sha1_worker(void *arg);
 
 #endif 
\ No newline at end of file
@@ -23,12 +23,23 @@ struct pignoufs
   int32_t nb_a;     // Nombre de blocs allouables (little-endian)
   int32_t nb_l;     // Nombre de blocs allouables libres (little-endian)
   int32_t nb_f;     // Nombre de fichiers stockés = inodes alloués (little-endian)
-  char zero[3972];  // Padding pour atteindre 4000 octets
+  int32_t alloc_hint; // Curseur next-fit de l'allocateur de blocs (0 = début de la zone de données)
+  int32_t inode_hint; // Aucun inode libre avant ce bloc (0 = début de la zone d'inodes)
+  int32_t root_inode; // Bloc de l'inode du répertoire racine (valide avec PFS_FEATURE_ROOT)
+  uint32_t features;  // Fonctionnalités du format présentes dans le conteneur (PFS_FEATURE_*)
+  char zero[3956];  // Padding pour atteindre 4000 octets
   uint8_t sha1[20]; // SHA1 du contenu
   uint32_t type;    // Type du bloc (1 pour superbloc, little-endian)
   char padding[72]; // Padding pour atteindre 4096 octets
 };
 
+// Le conteneur a un inode racine : les entrées de premier niveau sont ses enfants
+#define PFS_FEATURE_ROOT (1u << 0)
+// Chaque inode rattaché à un répertoire connaît son parent (champ parent)
+#define PFS_FEATURE_PARENT (1u << 1)
+// Tailles de fichiers sur 64 bits (file_size_hi) et niveau d'indirection triple
+#define PFS_FEATURE_SIZE64 (1u << 2)
+
 struct bitmap_block
 {
   uint8_t bits[4000]; // 32 000 bits (4 000 octets)
@@ -47,13 +58,32 @@ struct inode
   char filename[256];            // Nom du fichier (255 + 1 pour '\0')
   int32_t direct_blocks[900];    // Pointeurs directs vers les blocs de données
   int32_t double_indirect_block; // Pointeur vers un bloc d'indirection double
-  char extensions[120];          // Zone pour extensions (optionnelle)
+  int32_t dir_index;             // Répertoire : bloc d'en-tête de l'index des noms (0 = pas d'index)
+  int32_t dir_free;              // Répertoire : aucune case libre avant cette position
+  int32_t parent;                // Bloc de l'inode du répertoire parent (0 = racine ou inconnu)
+  uint32_t file_size_hi;         // 32 bits de poids fort de la taille (little-endian)
+  int32_t triple_indirect_block; // Bloc d'indirection triple, au-delà de la double (0 = aucun)
+  char extensions[100];          // Zone pour extensions (optionnelle)
   uint8_t sha1[20];              // SHA1 du contenu
   uint32_t type;                 // Type du bloc (3 pour inode, little-endian)
   int32_t profondeur;            // Profondeur de l'arborescence
   char padding[68];              // Padding
 };
 
+// Fichier décrit par extents (flags) : les cases directes de l'inode contiennent des struct extent
+// triées par rang logique (longueur <= 0 après la dernière), sans bloc d'indirection. Au-delà de
+// INODE_EXTENTS_MAX séries, le fichier repasse à l'adressage par blocs
+#define INODE_EXTENTS (1u << 6)
+#define INODE_EXTENTS_MAX 300
+
+// Série de blocs physiquement consécutifs d'un fichier (little-endian)
+struct extent
+{
+  int32_t logical; // Rang logique du premier bloc
+  int32_t start;   // Premier bloc physique
+  int32_t length;  // Nombre de blocs
+};
+
 struct data_block
 {
   char data[4000];  // Données du fichier
@@ -66,10 +96,23 @@ struct address_block
 {
   int32_t addresses[1000]; // Pointeurs vers d'autres blocs
   uint8_t sha1[20];        // SHA1 du contenu
-  uint32_t type;           // Type du bloc (6 pour indirection simple, 7 pour double) (little-endian)
+  uint32_t type;           // Type du bloc (6 pour indirection simple, 7 pour double, 10 pour triple) (little-endian)
   char padding[72];        // Padding
 };
 
+// Index des noms d'un répertoire (hachage, sondage linéaire) : en-tête de type 8,
+// cases dans des blocs de type 9 (struct address_block, -1 case vide, -2 case libérée)
+struct dir_index_block
+{
+  int32_t nb_slot_blocks;   // Nombre de blocs de cases (capacité : 1000 cases par bloc)
+  int32_t count;            // Entrées présentes
+  int32_t tombstones;       // Cases libérées
+  int32_t slot_blocks[997]; // Blocs de cases
+  uint8_t sha1[20];         // SHA1 du contenu
+  uint32_t type;            // Type du bloc (8 pour en-tête d'index, little-endian)
+  char padding[72];         // Padding
+};
+
 // Macros pour conversion endian
 #define TO_LE32(x) htole32(x)
 #define FROM_LE32(x) le32toh(x)
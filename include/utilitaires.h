@@ -10,6 +10,34 @@
 int print_error(const char *msg);
 void fatal_error(const char *msg);
 void split_path(const char *path, char *parent_path, char *dir_name);
+// Politique de vérification des SHA1 par les helpers d'accès aux blocs
+enum verify_policy
+{
+  VERIFY_ALWAYS,   // À chaque accès
+  VERIFY_ONCE,     // Une fois par bloc et par processus (par défaut)
+  VERIFY_FSCK_ONLY // Uniquement par fsck
+};
+void set_verify_policy(enum verify_policy policy);
+enum verify_policy get_verify_policy(void);
+// Écriture sur disque des blocs modifiés, à la fermeture (close_fs)
+enum sync_mode
+{
+  SYNC_FULL,  // msync(MS_SYNC) des seuls blocs modifiés (par défaut)
+  SYNC_ASYNC, // msync(MS_ASYNC) : écriture lancée sans l'attendre
+  SYNC_NONE   // Aucun msync (conteneur jetable) : le noyau écrit quand il veut
+};
+void set_sync_mode(enum sync_mode mode);
+enum sync_mode get_sync_mode(void);
+// Limite en Mo de la partie du conteneur gardée chargée (fenêtres de 64 Mo), 0 pour aucune limite
+void set_resident_limit(int32_t mb);
+// Vrai si une limite de mémoire chargée est fixée
+bool resident_limited(void);
+// Recalcul différé du SHA1 d'un bloc après écriture (effectué par commit_dirty_blocks ou close_fs)
+void update_block_sha1(void *blk);
+void commit_dirty_blocks(void);
+void invalidate_block(const void *blk);
+// Vérifie le SHA1 de plusieurs blocs d'un coup (calcul par lots), selon la politique courante
+void verify_blocks(uint8_t *map, const int32_t *blocks, int n);
 // Helpers pour accéder aux blocs
 struct pignoufs *get_superblock(uint8_t *map);
 struct bitmap_block *get_bitmap_block(uint8_t *map, int32_t b);
@@ -25,19 +53,89 @@ void increment_nb_f(uint8_t *map);
 bool check_bitmap_bit(uint8_t *map, int32_t blknum);
 // Initialisation d'un inode, fichier simple pour l'instant
 void init_inode(struct inode *in, const char *name, bool type);
+// Taille d'un fichier sur 64 bits (file_size et file_size_hi)
+uint64_t inode_size(const struct inode *in);
+void set_inode_size(struct inode *in, uint64_t size);
+// Façon dont une commande parcourt le conteneur, traduite en conseils au noyau à l'ouverture
+enum access_profile
+{
+  ACCESS_DEFAULT,    // Aucun conseil
+  ACCESS_RANDOM,     // Accès ponctuels : MADV_RANDOM, pas de lecture anticipée inutile
+  ACCESS_SEQUENTIAL, // Fichiers lus ou écrits d'un bout à l'autre : MADV_SEQUENTIAL
+  ACCESS_SCAN        // Tout le conteneur parcouru une seule fois (fsck) : comme séquentiel, pages rendues après usage
+};
+// Profil imposé à toutes les ouvertures (option --access), à la place de celui de la commande
+void set_access_override(enum access_profile profile);
+// Profil effectif d'une ouverture demandée avec profile (celui de --access s'il est imposé)
+enum access_profile effective_access_profile(enum access_profile profile);
 // Ouverture du système de fichiers et projection en mémoire
-int open_fs(const char *fsname, uint8_t **map, size_t *size);
+int open_fs(const char *fsname, uint8_t **map, size_t *size, enum access_profile profile);
+// Ouverture en lecture seule pour les commandes qui ne modifient rien (pas de msync à la fermeture)
+int open_fs_ro(const char *fsname, uint8_t **map, size_t *size, enum access_profile profile);
 // Fermeture du système de fichiers et synchronisation
 void close_fs(int fd, uint8_t *map, size_t size);
 void bitmap_alloc(uint8_t *map, int32_t blknum);
+// Inode du répertoire racine (-1 pour un ancien conteneur)
+int32_t get_root_inode(uint8_t *map);
+void add_root_entry(uint8_t *map, int32_t val);
+void delete_root_entry(uint8_t *map, int32_t val);
 int find_inode_racine(uint8_t *map, int32_t nb1, int32_t nbi, const char *name, bool type);
 int find_file_folder_from_inode(uint8_t *map, struct inode *in, const char *name, bool type);
 int find_inode_folder(uint8_t *map, int32_t nb1, int32_t nbi, const char *name);
-void add_inode(struct inode *in, int val);
-void delete_separte_inode(struct inode *in, int val);
+// Chemin interne complet d'un inode ("/a/b/c", "/" pour la racine), obtenu en remontant ses parents
+void inode_path(uint8_t *map, int32_t ino, char *buf, size_t len);
+// Nombre maximal d'entrées d'un répertoire : cases directes puis 1000 pages de 1000 cases
+#define DIR_MAX_ENTRIES (900 + 1000 * 1000)
+// Nombre maximal de blocs d'un fichier : directs, simple ou double indirection, puis indirection triple
+#define FILE_MAX_BLOCKS (900 + 1000 * 1000 + 1000LL * 1000 * 1000)
+// Parcours des enfants d'un répertoire, page par page
+struct dir_iter
+{
+  uint8_t *map;
+  struct inode *dir;
+  int64_t pos;                // Prochaine case à examiner
+  struct address_block *page; // Page de cases en cours (au-delà des cases directes)
+};
+void dir_iter_init(struct dir_iter *it, uint8_t *map, struct inode *dir);
+// Enfant suivant (numéro du bloc d'inode), -1 à la fin du répertoire
+int32_t dir_iter_next(struct dir_iter *it);
+// Retire du répertoire l'enfant rendu par le dernier dir_iter_next (case et index)
+void dir_iter_remove(struct dir_iter *it);
+// Parcours des blocs de données d'un fichier (directs, puis simple ou double indirection, ou extents)
+// par séries de blocs physiquement consécutifs ; les trous sont sautés et la lecture est anticipée par madvise
+struct block_iter
+{
+  uint8_t *map;
+  struct inode *in;
+  int64_t pos;                // Rang logique du prochain bloc à examiner
+  int64_t run_pos;            // Rang logique du premier bloc de la dernière série rendue
+  struct address_block *ind;  // Bloc d'indirection de l'inode (NULL s'il n'y en a pas)
+  int32_t ind_type;           // 6 (simple) ou 7 (double indirection)
+  struct address_block *tri;  // Bloc d'indirection triple (NULL s'il n'y en a pas)
+  struct address_block *mid;  // Bloc de type 7 en cours sous l'indirection triple
+  int32_t mid_outer;          // Case de ce bloc dans l'indirection triple (-1 si aucun)
+  struct address_block *page; // Page de 1000 blocs en cours
+  int64_t page_key;           // Numéro de cette page (-1 si aucune)
+  int32_t ext;                // Prochain extent à examiner (fichier décrit par extents)
+};
+void block_iter_init(struct block_iter *it, uint8_t *map, struct inode *in);
+// Série suivante : *first reçoit son premier bloc physique, renvoie sa longueur (0 à la fin du fichier)
+int32_t block_iter_next_run(struct block_iter *it, int32_t *first);
+void add_inode(uint8_t *map, struct inode *in, int val);
+void delete_separte_inode(uint8_t *map, struct inode *in, int val);
 int32_t alloc_data_block(uint8_t *map);
+// Allocation de n blocs par séries contiguës, retourne le nombre de blocs obtenus
+int32_t alloc_data_blocks(uint8_t *map, int32_t n, int32_t out[]);
+// Réserve des blocs consommés ensuite par alloc_data_block (les restants sont rendus à la fermeture)
+int32_t reserve_data_blocks(uint8_t *map, int32_t n);
+void reserve_for_append(uint8_t *map, struct inode *in, uint64_t len);
+void reserve_for_fd(uint8_t *map, struct inode *in, int fd);
 void bitmap_dealloc(uint8_t *map, int32_t blknum);
+// Rend un bloc de données ou d'adresses au bitmap (redevenu bloc libre, type 4)
+void release_block(uint8_t *map, int32_t b);
 void dealloc_data_block(struct inode *in, uint8_t *map, int fd, size_t size);
+// Allocation d'un inode libre (bloc d'inode, -1 s'il n'y en a plus)
+int32_t alloc_inode(uint8_t *map);
 int create_file(uint8_t *map, const char *filename);
 void delete_inode(struct inode *in, uint8_t *map, int pos, int fd, size_t size);
 int create_directory_main(uint8_t *map, const char *dirname, int profondeur);
@@ -46,6 +144,17 @@ int create_directory(uint8_t *map, char *dirname);
 int32_t get_last_data_block(uint8_t *map, struct inode *in);
 // Pour les calculs ont suppose qu'on ait des blocs pleins
 int32_t get_last_data_block_null(uint8_t *map, struct inode *in);
+// Bloc de données de rang index d'un fichier, calculé directement sur les niveaux d'adresses.
+// Avec create, les blocs manquants (données et adresses) sont alloués ; -1 pour un trou ou faute de place
+int32_t file_block_at(uint8_t *map, struct inode *in, int64_t index, bool create);
+// Passe un fichier décrit par extents à l'adressage par blocs (sans effet sinon) ; -1 faute de place
+int file_use_blocks(uint8_t *map, struct inode *in);
+// Libère le bloc de données de rang index (trou ensuite), sans effet sur un trou
+void file_block_punch(uint8_t *map, struct inode *in, int64_t index);
+// Rend les blocs d'adresses qui ne référencent plus aucun bloc (après file_block_punch)
+void file_release_empty_pages(uint8_t *map, struct inode *in);
+// Position d'un bloc projeté dans le conteneur (décalage à passer à lock_block)
+int64_t block_offset_of(const uint8_t *map, const void *blk);
 // Verrouiller un bloc pour lecture ou écriture
 int lock_block(int fd, int64_t block_offset, int lock_type);
 // Déverrouiller un bloc
@@ -0,0 +1,23 @@
+#ifndef VERROUS_H
+#define VERROUS_H
+
+#include "structures.h"
+
+// Table des verrous de blocs partagée par les processus qui ont ouvert le même conteneur : un mot
+// de 32 bits par bloc dans un segment de mémoire partagée, pris et rendu sans appel système quand
+// personne n'attend (futex sinon). Le conteneur lui-même n'est pas modifié, même ouvert en lecture seule.
+
+// Ouvre (ou crée) la table du conteneur ouvert sur fd, de nbb blocs ; le segment a le propriétaire et
+// les droits du conteneur. Sans table, les verrous passent par fcntl pour tous les processus du
+// conteneur : si la table sert déjà à d'autres, on attend qu'ils l'aient fermée
+bool lock_table_open(int fd, int64_t nbb);
+// Ferme la table de la session (fin de session)
+void lock_table_close(void);
+// Vrai si les verrous du conteneur ouvert sur fd passent par la table
+bool lock_table_covers(int fd);
+// Verrou de lecture (partagé) ou d'écriture (exclusif) du bloc b ; une lecture déjà tenue passe en
+// écriture. Faux (errno) si b est hors de la table ou si le passage en écriture s'interbloquerait
+bool lock_table_lock(int fd, int64_t b, bool write);
+bool lock_table_unlock(int fd, int64_t b);
+
+#endif
@@ -0,0 +1,114 @@
+#include "../include/cache_chemins.h"
+#include "../include/utilitaires.h"
+
+// Cache à correspondance directe : une entrée par valeur de hachage, la plus récente gagne
+struct dentry
+{
+  char path[256]; // Chemin normalisé ("a/b/c", sans '/' en trop)
+  int32_t inode;  // 0 = entrée vide
+};
+
+static struct dentry dentry_cache[DENTRY_CACHE_SIZE];
+
+// FNV-1a 32 bits
+static uint32_t hash_path(const char *path)
+{
+  uint32_t h = 2166136261u;
+  for (const unsigned char *p = (const unsigned char *)path; *p; p++)
+  {
+    h ^= *p;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// Supprime les '/' en tête, en fin et répétés pour que "a//b/" et "a/b" partagent la même entrée
+static bool normalize_path(const char *path, char *out)
+{
+  size_t n = 0;
+  for (const char *p = path; *p; p++)
+  {
+    if (*p == '/' && (n == 0 || out[n - 1] == '/'))
+      continue;
+    if (n == 255)
+      return false;
+    out[n++] = *p;
+  }
+  if (n > 0 && out[n - 1] == '/')
+    n--;
+  out[n] = '\0';
+  return n > 0;
+}
+
+int32_t dentry_cache_lookup(uint8_t *map, const char *path)
+{
+  char key[256];
+  if (!normalize_path(path, key))
+    return -1;
+  struct dentry *d = &dentry_cache[hash_path(key) % DENTRY_CACHE_SIZE];
+  if (d->inode == 0 || strcmp(d->path, key) != 0)
+    return -1;
+  // L'inode doit encore être le répertoire du chemin : chaque composant, du dernier au premier, est
+  // comparé au nom de l'inode atteint en remontant les parents, et le premier doit être à la racine.
+  // Sans parents enregistrés (ancien conteneur), l'entrée n'est pas vérifiable et n'est pas servie
+  if (!(FROM_LE32(get_superblock(map)->features) & PFS_FEATURE_PARENT))
+    return -1;
+  int32_t root = get_root_inode(map);
+  int32_t ino = d->inode;
+  size_t end = strlen(key);
+  while (end > 0)
+  {
+    size_t start = end;
+    while (start > 0 && key[start - 1] != '/')
+      start--;
+    struct inode *in = ino > 0 && ino != root ? get_inode(map, ino) : NULL;
+    uint32_t flags = in ? FROM_LE32(in->flags) : 0;
+    if (!(flags & 1) || !((flags >> 5) & 1) || strlen(in->filename) != end - start ||
+        strncmp(in->filename, key + start, end - start) != 0)
+    {
+      d->inode = 0;
+      return -1;
+    }
+    ino = FROM_LE32(in->parent);
+    end = start > 0 ? start - 1 : 0;
+  }
+  if (ino != (root >= 0 ? root : 0))
+  {
+    d->inode = 0;
+    return -1;
+  }
+  return d->inode;
+}
+
+void dentry_cache_insert(const char *path, int32_t inode)
+{
+  char key[256];
+  if (inode <= 0 || !normalize_path(path, key))
+    return;
+  struct dentry *d = &dentry_cache[hash_path(key) % DENTRY_CACHE_SIZE];
+  strcpy(d->path, key);
+  d->inode = inode;
+}
+
+void dentry_cache_invalidate(const char *path)
+{
+  char key[256];
+  if (!normalize_path(path, key))
+  {
+    dentry_cache_clear();
+    return;
+  }
+  size_t len = strlen(key);
+  for (int i = 0; i < DENTRY_CACHE_SIZE; i++)
+  {
+    struct dentry *d = &dentry_cache[i];
+    if (d->inode != 0 && strncmp(d->path, key, len) == 0 && (d->path[len] == '\0' || d->path[len] == '/'))
+      d->inode = 0;
+  }
+}
+
+void dentry_cache_clear(void)
+{
+  for (int i = 0; i < DENTRY_CACHE_SIZE; i++)
+    dentry_cache[i].inode = 0;
+}
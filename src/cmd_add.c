@@ -7,7 +7,7 @@ int cmd_add(const char *fsname, const char *filename_ext, const char *filename_i
   uint8_t *map;
   size_t size;
   // Ouvre le système de fichiers et mappe son contenu en mémoire
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs(fsname, &map, &size, ACCESS_SEQUENTIAL);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -36,6 +36,7 @@ int cmd_add(const char *fsname, const char *filename_ext, const char *filename_i
     {
       // Crée le fichier s'il n'existe pas
       val = create_file(map, dir_name);
+      add_root_entry(map, val);
     }
     in = get_inode(map, val);
   }
@@ -52,7 +53,7 @@ int cmd_add(const char *fsname, const char *filename_ext, const char *filename_i
       val = create_file(map, dir_name);
       struct inode *in2 = get_inode(map, val);
       in2->profondeur = TO_LE32(FROM_LE32(in->profondeur) + 1);
-      add_inode(in, val);
+      add_inode(map, in, val);
       in = in2;
     }
     else
@@ -66,7 +67,7 @@ int cmd_add(const char *fsname, const char *filename_ext, const char *filename_i
         val = create_file(map, dir_name);
         struct inode *in2 = get_inode(map, val);
         in2->profondeur = TO_LE32(FROM_LE32(in->profondeur) + 1);
-        add_inode(in, val);
+        add_inode(map, in, val);
         in = in2;
       }
       else
@@ -78,7 +79,7 @@ int cmd_add(const char *fsname, const char *filename_ext, const char *filename_i
   }
 
   // Verrouille l'inode pour éviter les accès concurrents
-  int inode_offset = (1 + nb1) * 4096 + (int64_t)(in - (struct inode *)map);
+  int64_t inode_offset = block_offset_of(map, in);
   if (lock_block(fd, inode_offset, F_WRLCK) < 0)
   {
     print_error("Erreur lors du verrouillage de l'inode");
@@ -86,7 +87,9 @@ int cmd_add(const char *fsname, const char *filename_ext, const char *filename_i
     return 1;
   }
 
-  uint32_t total = FROM_LE32(in->file_size);
+  uint64_t total = inode_size(in);
+  // Taille connue (fichier régulier) : tous les blocs sont alloués d'un coup, contigus si possible
+  reserve_for_fd(map, in, inf);
   uint32_t offset = (total % 4000);
   char buf[4000];
   size_t r;
@@ -96,7 +99,7 @@ int cmd_add(const char *fsname, const char *filename_ext, const char *filename_i
     // Si le dernier bloc de données n'est pas plein, le compléter
     int32_t last = get_last_data_block(map, in);
     // Verrouille le dernier bloc de données
-    if (lock_block(fd, last * 4096, F_WRLCK) < 0)
+    if (lock_block(fd, (int64_t)last * 4096, F_WRLCK) < 0)
     {
       print_error("Erreur lors du verrouillage du dernier bloc de données");
       unlock_block(fd, inode_offset);
@@ -108,7 +111,7 @@ int cmd_add(const char *fsname, const char *filename_ext, const char *filename_i
     if ((int32_t)r == -1)
     {
       print_error("read source: erreur de lecture du fichier externe");
-      unlock_block(fd, last * 4096);
+      unlock_block(fd, (int64_t)last * 4096);
       unlock_block(fd, inode_offset);
       close_fs(fd, map, size);
       return 1;
@@ -116,19 +119,19 @@ int cmd_add(const char *fsname, const char *filename_ext, const char *filename_i
     if (r == 0)
     {
       // Fin du fichier externe
-      unlock_block(fd, last * 4096);
+      unlock_block(fd, (int64_t)last * 4096);
       unlock_block(fd, inode_offset);
       close_fs(fd, map, size);
       return 0;
     }
     struct data_block *db = get_data_block(map, last);
     memcpy(db->data + offset, buf, r);
-    calcul_sha1(db->data, 4000, db->sha1);
+    update_block_sha1(db);
     total += r;
-    in->file_size = TO_LE32(total);
+    set_inode_size(in, total);
 
     // Déverrouille le dernier bloc de données
-    unlock_block(fd, last * 4096);
+    unlock_block(fd, (int64_t)last * 4096);
   }
 
   // Boucle pour lire et écrire les blocs suivants
@@ -141,31 +144,21 @@ int cmd_add(const char *fsname, const char *filename_ext, const char *filename_i
       break;
     }
 
-    // Verrouille le nouveau bloc de données
-    if (lock_block(fd, b * 4096, F_WRLCK) < 0)
-    {
-      print_error("Erreur lors du verrouillage du bloc de données");
-      unlock_block(fd, inode_offset);
-      close_fs(fd, map, size);
-      return 1;
-    }
-
+    // Nouveau bloc, atteint seulement par l'inode verrouillé : pas de verrou propre, ses SHA1
+    // sont écrits en une fois quand l'inode est déverrouillé
     struct data_block *db = get_data_block(map, b);
     memset(db->data, 0, sizeof(db->data));
     memcpy(db->data, buf, r);
-    calcul_sha1(db->data, 4000, db->sha1);
+    update_block_sha1(db);
     db->type = TO_LE32(5);
     total += r;
-    in->file_size = TO_LE32(total);
-
-    // Déverrouille le nouveau bloc de données
-    unlock_block(fd, b * 4096);
+    set_inode_size(in, total);
   }
 
   // Met à jour la taille et la date de modification du fichier
-  in->file_size = TO_LE32(total);
+  set_inode_size(in, total);
   in->modification_time = TO_LE32(time(NULL));
-  calcul_sha1(in, 4000, in->sha1);
+  update_block_sha1(in);
 
   // Déverrouille l'inode
   unlock_block(fd, inode_offset);
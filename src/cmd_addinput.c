@@ -1,5 +1,6 @@
 #include "../include/structures.h"
 #include "../include/utilitaires.h"
+#include "../include/lecture_ecriture.h"
 
 // Fonction pour ajouter le contenu de l'entrée standard dans un fichier du système de fichiers interne
 int cmd_addinput(const char *fsname, const char *filename)
@@ -7,7 +8,7 @@ int cmd_addinput(const char *fsname, const char *filename)
   uint8_t *map;
   size_t size;
   // Ouvre le système de fichiers et mappe son contenu en mémoire
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs(fsname, &map, &size, ACCESS_SEQUENTIAL);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -29,6 +30,7 @@ int cmd_addinput(const char *fsname, const char *filename)
     {
       // Crée le fichier s'il n'existe pas
       val = create_file(map, dir_name);
+      add_root_entry(map, val);
     }
     in = get_inode(map, val);
   }
@@ -45,7 +47,7 @@ int cmd_addinput(const char *fsname, const char *filename)
       val = create_file(map, dir_name);
       struct inode *in2 = get_inode(map, val);
       in2->profondeur = TO_LE32(FROM_LE32(in->profondeur) + 1);
-      add_inode(in, val);
+      add_inode(map, in, val);
       in = in2;
     }
     else
@@ -59,7 +61,7 @@ int cmd_addinput(const char *fsname, const char *filename)
         val = create_file(map, dir_name);
         struct inode *in2 = get_inode(map, val);
         in2->profondeur = TO_LE32(FROM_LE32(in->profondeur) + 1);
-        add_inode(in, val);
+        add_inode(map, in, val);
         in = in2;
       }
       else
@@ -71,7 +73,7 @@ int cmd_addinput(const char *fsname, const char *filename)
   }
 
   // Verrouille l'inode pour éviter les accès concurrents
-  int inode_offset = (1 + nb1) * 4096 + (int64_t)(in - (struct inode *)map);
+  int64_t inode_offset = block_offset_of(map, in);
   if (lock_block(fd, inode_offset, F_WRLCK) < 0)
   {
     print_error("Erreur lors du verrouillage de l'inode");
@@ -79,73 +81,27 @@ int cmd_addinput(const char *fsname, const char *filename)
     return 1;
   }
 
-  uint32_t total = FROM_LE32(in->file_size);
+  uint64_t total = inode_size(in);
+  // Taille connue (fichier régulier) : tous les blocs sont alloués d'un coup, contigus si possible
+  reserve_for_fd(map, in, STDIN_FILENO);
   char buf[4000];
-  size_t r;
+  ssize_t r;
 
-  // Boucle de lecture depuis l'entrée standard et écriture dans le fichier interne
+  // Boucle de lecture depuis l'entrée standard et ajout à la fin du fichier interne
+  // (un morceau lu peut déborder du dernier bloc entamé sur le suivant)
   while ((r = read(STDIN_FILENO, buf, 4000)) > 0)
   {
-    uint32_t offset = (total % 4000);
-    if (offset > 0)
-    {
-      // Si le dernier bloc de données n'est pas plein, le compléter
-      int32_t last = get_last_data_block(map, in);
-
-      // Verrouille le dernier bloc de données
-      if (lock_block(fd, last * 4096, F_WRLCK) < 0)
-      {
-        print_error("Erreur lors du verrouillage du dernier bloc de données");
-        unlock_block(fd, inode_offset);
-        close_fs(fd, map, size);
-        return 1;
-      }
-
-      struct data_block *db = get_data_block(map, last);
-      memcpy(db->data + offset, buf, r);
-      calcul_sha1(db->data, 4000, db->sha1);
-      total += r;
-      in->file_size = TO_LE32(total);
-
-      // Déverrouille le dernier bloc de données
-      unlock_block(fd, last * 4096);
-    }
-    else
-    {
-      // Sinon, alloue un nouveau bloc de données
-      int32_t b = get_last_data_block_null(map, in);
-      if (b == -2)
-      {
-        print_error("Erreur: pas de blocs de données libres disponibles");
-        break;
-      }
-
-      // Verrouille le nouveau bloc de données
-      if (lock_block(fd, b * 4096, F_WRLCK) < 0)
-      {
-        print_error("Erreur lors du verrouillage du bloc de données");
-        unlock_block(fd, inode_offset);
-        close_fs(fd, map, size);
-        return 1;
-      }
-
-      struct data_block *db = get_data_block(map, b);
-      memset(db->data, 0, sizeof(db->data));
-      memcpy(db->data, buf, r);
-      calcul_sha1(db->data, 4000, db->sha1);
-      db->type = TO_LE32(5);
-      total += r;
-      in->file_size = TO_LE32(total);
-
-      // Déverrouille le nouveau bloc de données
-      unlock_block(fd, b * 4096);
-    }
+    ssize_t w = pfs_pwrite(map, in, buf, r, total);
+    if (w > 0)
+      total += w;
+    if (w != r)
+      break;
   }
 
   // Met à jour la taille et la date de modification du fichier
-  in->file_size = TO_LE32(total);
+  set_inode_size(in, total);
   in->modification_time = TO_LE32(time(NULL));
-  calcul_sha1(in, 4000, in->sha1);
+  update_block_sha1(in);
 
   // Déverrouille l'inode
   unlock_block(fd, inode_offset);
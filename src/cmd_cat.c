@@ -1,5 +1,72 @@
 #include "../include/structures.h"
 #include "../include/utilitaires.h"
+#include <sys/uio.h>
+#include <errno.h>
+
+// Nombre de blocs envoyés par appel système
+#define CAT_BATCH 256
+
+// Lot de blocs consécutifs du fichier, envoyés ensemble sur la sortie standard
+struct cat_batch
+{
+  uint8_t *map;
+  int32_t blocks[CAT_BATCH]; // Blocs de données du lot (les trous n'en ont pas)
+  struct iovec iov[CAT_BATCH];
+  int n;                     // Nombre d'iovecs du lot
+  int nb;                    // Nombre de blocs de données du lot
+  uint64_t remaining; // Octets du fichier pas encore ajoutés au lot
+};
+
+// Vérifie les SHA1 du lot par calcul groupé, puis l'envoie en un appel (ou plusieurs si écriture partielle).
+// writev copie les données, y compris vers un tube : le lecteur ne voit pas les écritures faites
+// dans le conteneur après la vérification et le verrou (ce que ferait un tube qui référence les pages)
+static int cat_flush(struct cat_batch *c)
+{
+  if (c->n == 0)
+    return 0;
+  verify_blocks(c->map, c->blocks, c->nb);
+  struct iovec *iov = c->iov;
+  int cnt = c->n;
+  while (cnt > 0)
+  {
+    ssize_t w = writev(STDOUT_FILENO, iov, cnt);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w < 0)
+      return 1;
+    // Avance dans les iovecs après une écriture partielle
+    while (cnt > 0 && (size_t)w >= iov->iov_len)
+    {
+      w -= iov->iov_len;
+      iov++;
+      cnt--;
+    }
+    if (cnt > 0)
+    {
+      iov->iov_base = (uint8_t *)iov->iov_base + w;
+      iov->iov_len -= w;
+    }
+  }
+  c->n = 0;
+  c->nb = 0;
+  return 0;
+}
+
+// Contenu d'un bloc absent (trou d'un fichier creux)
+static const uint8_t zero_block[4000];
+
+// Ajoute le contenu d'un bloc de données au lot, ou des zéros pour un trou (b < 0)
+static int cat_push(struct cat_batch *c, int32_t b)
+{
+  uint32_t len = c->remaining < 4000 ? c->remaining : 4000;
+  if (b >= 0)
+    c->blocks[c->nb++] = b;
+  c->iov[c->n].iov_base = b >= 0 ? (void *)(c->map + (int64_t)b * 4096) : (void *)zero_block;
+  c->iov[c->n].iov_len = len;
+  c->n++;
+  c->remaining -= len;
+  return c->n == CAT_BATCH ? cat_flush(c) : 0;
+}
 
 // Fonction pour afficher le contenu d'un fichier du système de fichiers interne sur la sortie standard
 int cmd_cat(const char *fsname, const char *filename)
@@ -7,7 +74,7 @@ int cmd_cat(const char *fsname, const char *filename)
   uint8_t *map;
   size_t size;
   // Ouvre le système de fichiers et mappe son contenu en mémoire
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs_ro(fsname, &map, &size, ACCESS_SEQUENTIAL);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -62,121 +129,39 @@ int cmd_cat(const char *fsname, const char *filename)
     close_fs(fd, map, size);
     return 1;
   }
-  uint32_t file_size = FROM_LE32(in->file_size);
-  uint32_t remaining_data = file_size;
-
-  // 1) Parcours des blocs directs
-  for (int i = 0; i < 900 && remaining_data > 0; i++)
+  // Verrou en lecture sur l'inode pour toute la durée de la copie (et non bloc par bloc)
+  int64_t inode_offset = block_offset_of(map, in);
+  if (lock_block(fd, inode_offset, F_RDLCK) < 0)
   {
-    int32_t b = FROM_LE32(in->direct_blocks[i]);
-    if (b < 0)
-      break;
-
-    // Verrouille le bloc source pour lecture
-    if (lock_block(fd, b * 4096, F_RDLCK) < 0)
-    {
-      print_error("Erreur lors du verrouillage du bloc source");
-      close_fs(fd, map, size);
-      return 1;
-    }
-
-    struct data_block *data_position = get_data_block(map, b);
-    uint32_t buffer = remaining_data < 4000 ? remaining_data : 4000;
-    int written = write(STDOUT_FILENO, data_position->data, buffer);
-    if (written == -1)
-    {
-      print_error("write: erreur d'écriture");
-      unlock_block(fd, b * 4096);
-      close_fs(fd, map, size);
-      return 1;
-    }
-    remaining_data -= buffer;
-
-    // Déverrouille le bloc source
-    unlock_block(fd, b * 4096);
-  }
-
-  // Récupère le bloc double indirect si besoin
-  int32_t dib = FROM_LE32(in->double_indirect_block);
-  if (remaining_data == 0 || dib < 0)
-  {
-    goto end;
-  }
-
-  // 2) Parcours des blocs indirects ou double indirects
-  struct address_block *dbl = get_address_block(map, dib);
-  if (FROM_LE32(dbl->type) == 6)
-  {
-    // Simple indirect
-    for (int i = 0; i < 1000 && remaining_data > 0; i++)
-    {
-      int32_t db = FROM_LE32(dbl->addresses[i]);
-      if (db < 0)
-        continue; // Cas fichier à trou
-
-      // Verrouille le bloc source
-      if (lock_block(fd, db * 4096, F_RDLCK) < 0)
-      {
-        print_error("Erreur lors du verrouillage du bloc source");
-        close_fs(fd, map, size);
-        return 1;
-      }
-
-      struct data_block *data_position2 = get_data_block(map, db);
-      uint32_t buffer = remaining_data < 4000 ? remaining_data : 4000;
-      int written = write(STDOUT_FILENO, data_position2->data, buffer);
-      if (written == -1)
-      {
-        print_error("write: erreur d'écriture");
-        unlock_block(fd, db * 4096);
-        close_fs(fd, map, size);
-        return 1;
-      }
-      remaining_data -= buffer;
-      unlock_block(fd, db * 4096);
-    }
+    print_error("Erreur lors du verrouillage de l'inode");
+    close_fs(fd, map, size);
+    return 1;
   }
-  else
+  struct cat_batch c = {.map = map, .n = 0, .nb = 0, .remaining = inode_size(in)};
+  int ret = 0;
+
+  // Parcours des blocs du fichier par séries (directs, puis simple ou double indirection) ;
+  // les trous entre les séries et après la dernière sont envoyés comme des zéros
+  struct block_iter it;
+  block_iter_init(&it, map, in);
+  int32_t b, n;
+  int64_t pos = 0; // Rang logique du prochain bloc à envoyer
+  while (c.remaining > 0 && ret == 0 && (n = block_iter_next_run(&it, &b)) > 0)
   {
-    // Double indirect
-    for (int i = 0; i < 1000 && remaining_data > 0; i++)
-    {
-      int32_t db = FROM_LE32(dbl->addresses[i]);
-      if (db < 0)
-        continue; // Cas fichier à trou
-
-      struct address_block *ab2 = get_address_block(map, db);
-      for (int j = 0; j < 1000 && remaining_data > 0; j++)
-      {
-        int32_t db2 = FROM_LE32(ab2->addresses[j]);
-        if (db2 < 0)
-          continue; // Cas fichier à trou
-
-        // Verrouille le bloc source
-        if (lock_block(fd, db2 * 4096, F_RDLCK) < 0)
-        {
-          print_error("Erreur lors du verrouillage du bloc source");
-          close_fs(fd, map, size);
-          return 1;
-        }
-
-        struct data_block *data_position3 = get_data_block(map, db2);
-        uint32_t buffer = remaining_data < 4000 ? remaining_data : 4000;
-        int written = write(STDOUT_FILENO, data_position3->data, buffer);
-        if (written == -1)
-        {
-          print_error("write: erreur d'écriture");
-          unlock_block(fd, db2 * 4096);
-          close_fs(fd, map, size);
-          return 1;
-        }
-        remaining_data -= buffer;
-        unlock_block(fd, db2 * 4096);
-      }
-    }
+    for (; pos < it.run_pos && c.remaining > 0 && ret == 0; pos++)
+      ret = cat_push(&c, -1);
+    for (int32_t k = 0; k < n && c.remaining > 0 && ret == 0; k++, pos++)
+      ret = cat_push(&c, b + k);
   }
-end:
+  while (c.remaining > 0 && ret == 0)
+    ret = cat_push(&c, -1);
+  if (ret == 0)
+    ret = cat_flush(&c);
+  if (ret != 0)
+    print_error("write: erreur d'écriture");
+
+  unlock_block(fd, inode_offset);
   // Ferme le système de fichiers
   close_fs(fd, map, size);
-  return 0;
-}
\ No newline at end of file
+  return ret;
+}
@@ -7,7 +7,7 @@ int cmd_chmod(const char *fsname, const char *filename, const char *arg)
   uint8_t *map;
   size_t size;
   // Ouvre le système de fichiers et mappe son contenu en mémoire
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs(fsname, &map, &size, ACCESS_RANDOM);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -61,7 +61,7 @@ int cmd_chmod(const char *fsname, const char *filename, const char *arg)
   }
 
   // Verrouille l'inode pour modification
-  int inode_offset = (1 + nb1) * 4096 + (int64_t)(in - (struct inode *)map);
+  int64_t inode_offset = block_offset_of(map, in);
   if (lock_block(fd, inode_offset, F_WRLCK) < 0)
   {
     print_error("Erreur lors du verrouillage de l'inode");
@@ -96,7 +96,7 @@ int cmd_chmod(const char *fsname, const char *filename, const char *arg)
 
   // Met à jour la date de modification et le hash
   in->modification_time = TO_LE32(time(NULL));
-  calcul_sha1(in, 4000, in->sha1);
+  update_block_sha1(in);
 
   // Déverrouille l'inode
   unlock_block(fd, inode_offset);
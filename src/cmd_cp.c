@@ -1,159 +1,79 @@
 #include "../include/structures.h"
 #include "../include/utilitaires.h"
 
-static void copy_interne(uint8_t *map, struct inode *in, struct inode *in2, int fd)
+// Copie le contenu de in dans in2, dont l'appelant tient le verrou : les nouveaux blocs ne sont
+// atteints que par in2 et n'ont pas de verrou propre
+static void copy_interne(uint8_t *map, struct inode *in, struct inode *in2)
 {
-  for (int i = 0; i < 900; i++)
+  // Réserve d'un coup les blocs de la copie (données et adresses)
+  reserve_for_append(map, in2, inode_size(in));
+  // Chaque bloc source est recopié au même rang logique (les trous sont conservés)
+  struct block_iter it;
+  block_iter_init(&it, map, in);
+  int32_t old_blk, n;
+  while ((n = block_iter_next_run(&it, &old_blk)) > 0)
   {
-    if (in->direct_blocks[i] != -1)
+    for (int32_t k = 0; k < n; k++)
     {
-      int32_t old_blk = FROM_LE32(in->direct_blocks[i]);
-      lock_block(fd, old_blk * 4096, F_RDLCK);
-      struct data_block *data_position = get_data_block(map, old_blk);
-      int32_t new_block = alloc_data_block(map);
-      lock_block(fd, new_block * 4096, F_WRLCK);
+      set_inode_size(in2, (uint64_t)(it.run_pos + k) * 4000);
+      int32_t new_block = get_last_data_block_null(map, in2);
+      if (new_block < 0)
+        break;
       struct data_block *new_data_position = get_data_block(map, new_block);
-      memcpy(new_data_position->data, data_position->data, 4000);
-      in2->direct_blocks[i] = TO_LE32(new_block);
-      calcul_sha1(new_data_position->data, 4000, new_data_position->sha1);
-      unlock_block(fd, new_block * 4096);
-      unlock_block(fd, old_blk * 4096);
-    }
-  }
-  if ((int32_t)FROM_LE32(in->double_indirect_block) != -1)
-  {
-    int32_t dbl_blk = FROM_LE32(in->double_indirect_block);
-    lock_block(fd, dbl_blk * 4096, F_RDLCK);
-    struct address_block *dbl = get_address_block(map, dbl_blk);
-    if ((int32_t)FROM_LE32(dbl->type) == 6)
-    {
-      int32_t new_dbl_blk = alloc_data_block(map);
-      lock_block(fd, new_dbl_blk * 4096, F_WRLCK);
-      in2->double_indirect_block = TO_LE32(new_dbl_blk);
-      struct address_block *dbl2 = get_address_block(map, new_dbl_blk);
-      memset(dbl2->addresses, -1, sizeof(dbl2->addresses));
-      calcul_sha1(dbl2->addresses, 4000, dbl2->sha1);
-      calcul_sha1(in2, 4000, in2->sha1);
-      dbl2->type = TO_LE32(6);
-      for (int i = 0; i < 1000; i++)
-      {
-        if (dbl->addresses[i] != -1)
-        {
-          int32_t old_blk = FROM_LE32(dbl->addresses[i]);
-          lock_block(fd, old_blk * 4096, F_RDLCK);
-          struct data_block *data_position = get_data_block(map, old_blk);
-          int32_t new_block = alloc_data_block(map);
-          lock_block(fd, new_block * 4096, F_WRLCK);
-          struct data_block *new_data_position = get_data_block(map, new_block);
-          memcpy(new_data_position->data, data_position->data, 4000);
-          dbl2->addresses[i] = TO_LE32(new_block);
-          calcul_sha1(new_data_position->data, 4000, new_data_position->sha1);
-          unlock_block(fd, new_block * 4096);
-          unlock_block(fd, old_blk * 4096);
-        }
-      }
-      calcul_sha1(dbl2->addresses, 4000, dbl2->sha1);
-      unlock_block(fd, new_dbl_blk * 4096);
-    }
-    else
-    {
-      int32_t new_dbl_blk = alloc_data_block(map);
-      lock_block(fd, new_dbl_blk * 4096, F_WRLCK);
-      in2->double_indirect_block = TO_LE32(new_dbl_blk);
-      struct address_block *dbl2 = get_address_block(map, new_dbl_blk);
-      memset(dbl2->addresses, -1, sizeof(dbl2->addresses));
-      calcul_sha1(in2, 4000, in2->sha1);
-      dbl2->type = TO_LE32(7);
-
-      for (int i = 0; i < 1000; i++)
-      {
-        if (dbl->addresses[i] != -1)
-        {
-          int32_t sib_blk = FROM_LE32(dbl->addresses[i]);
-          lock_block(fd, sib_blk * 4096, F_RDLCK);
-          struct address_block *sib = get_address_block(map, sib_blk);
-          int32_t new_block = alloc_data_block(map);
-          lock_block(fd, new_block * 4096, F_WRLCK);
-          struct address_block *dbl3 = get_address_block(map, new_block);
-          memset(dbl3->addresses, -1, sizeof(dbl3->addresses));
-
-          dbl3->type = TO_LE32(6);
-          for (int j = 0; j < 1000; j++)
-          {
-            if (sib->addresses[j] != -1)
-            {
-              int32_t old_blk = FROM_LE32(sib->addresses[j]);
-              lock_block(fd, old_blk * 4096, F_RDLCK);
-              struct data_block *data_position = get_data_block(map, old_blk);
-              int32_t new_data_blk = alloc_data_block(map);
-              lock_block(fd, new_data_blk * 4096, F_WRLCK);
-              struct data_block *new_data_position = get_data_block(map, new_data_blk);
-              memcpy(new_data_position->data, data_position->data, 4000);
-              dbl3->addresses[j] = TO_LE32(new_data_blk);
-              calcul_sha1(new_data_position->data, 4000, new_data_position->sha1);
-              unlock_block(fd, new_data_blk * 4096);
-              unlock_block(fd, old_blk * 4096);
-            }
-          }
-          dbl2->addresses[i] = TO_LE32(new_block);
-          calcul_sha1(dbl3->addresses, 4000, dbl3->sha1);
-          unlock_block(fd, new_block * 4096);
-          unlock_block(fd, sib_blk * 4096);
-        }
-      }
-      calcul_sha1(dbl2->addresses, 4000, dbl2->sha1);
-      unlock_block(fd, new_dbl_blk * 4096);
+      memcpy(new_data_position->data, get_data_block(map, old_blk + k)->data, 4000);
+      update_block_sha1(new_data_position);
     }
-    unlock_block(fd, dbl_blk * 4096);
   }
+  set_inode_size(in2, inode_size(in));
+  update_block_sha1(in2);
 }
 
 static void copy_interne_main(uint8_t *map, struct inode *in, struct inode *in2, int fd)
 {
   int32_t new_block = alloc_data_block(map);
-  lock_block(fd, new_block * 4096, F_WRLCK);
+  lock_block(fd, (int64_t)new_block * 4096, F_WRLCK);
   struct inode *dossier = get_inode(map, new_block);
   dossier->profondeur = TO_LE32(FROM_LE32(in2->profondeur) + 1);
   init_inode(dossier, in->filename, true);
-  copy_interne(map, in, dossier, fd);
-  add_inode(in2, new_block);
-  calcul_sha1(dossier, 4000, dossier->sha1);
-  unlock_block(fd, new_block * 4096);
+  copy_interne(map, in, dossier);
+  add_inode(map, in2, new_block);
+  update_block_sha1(dossier);
+  unlock_block(fd, (int64_t)new_block * 4096);
 }
 
 static void copy_dossier(uint8_t *map, struct inode *in, struct inode *in2, int fd)
 {
-  for (int i = 0; i < 900; i++)
+  struct dir_iter it;
+  dir_iter_init(&it, map, in);
+  int32_t child_idx;
+  while ((child_idx = dir_iter_next(&it)) >= 0)
   {
-    if (in->direct_blocks[i] != -1)
+    struct inode *dossier = get_inode(map, child_idx);
+    if ((FROM_LE32(dossier->flags) >> 5) & 1)
     {
-      struct inode *dossier = get_inode(map, in->direct_blocks[i]);
-      if ((FROM_LE32(dossier->flags) >> 5) & 1)
-      {
-        int32_t new_block = alloc_data_block(map);
-        lock_block(fd, new_block * 4096, F_WRLCK);
-        struct inode *dossier2 = get_inode(map, new_block);
-        dossier2->profondeur = TO_LE32(FROM_LE32(in2->profondeur) + 1);
-        init_inode(dossier2, dossier->filename, true);
-        copy_dossier(map, dossier, dossier2, fd);
-        add_inode(in2, new_block);
-        calcul_sha1(dossier2, 4000, dossier2->sha1);
-        unlock_block(fd, new_block * 4096);
-      }
-      else
-      {
-        struct inode *fichier = get_inode(map, in->direct_blocks[i]);
-        int32_t new_block = alloc_data_block(map);
-        lock_block(fd, new_block * 4096, F_WRLCK);
-        init_inode(fichier, dossier->filename, false);
-        struct inode *fichier2 = get_inode(map, new_block);
-        fichier2->profondeur = TO_LE32(FROM_LE32(in2->profondeur) + 1);
-        init_inode(fichier2, fichier->filename, false);
-        copy_interne(map, fichier, fichier2, fd);
-        add_inode(in2, new_block);
-        calcul_sha1(fichier2, 4000, fichier2->sha1);
-        unlock_block(fd, new_block * 4096);
-      }
+      int32_t new_block = alloc_data_block(map);
+      lock_block(fd, (int64_t)new_block * 4096, F_WRLCK);
+      struct inode *dossier2 = get_inode(map, new_block);
+      dossier2->profondeur = TO_LE32(FROM_LE32(in2->profondeur) + 1);
+      init_inode(dossier2, dossier->filename, true);
+      copy_dossier(map, dossier, dossier2, fd);
+      add_inode(map, in2, new_block);
+      update_block_sha1(dossier2);
+      unlock_block(fd, (int64_t)new_block * 4096);
+    }
+    else
+    {
+      struct inode *fichier = get_inode(map, child_idx);
+      int32_t new_block = alloc_data_block(map);
+      lock_block(fd, (int64_t)new_block * 4096, F_WRLCK);
+      init_inode(fichier, dossier->filename, false);
+      struct inode *fichier2 = get_inode(map, new_block);
+      fichier2->profondeur = TO_LE32(FROM_LE32(in2->profondeur) + 1);
+      init_inode(fichier2, fichier->filename, false);
+      copy_interne(map, fichier, fichier2);
+      add_inode(map, in2, new_block);
+      update_block_sha1(fichier2);
+      unlock_block(fd, (int64_t)new_block * 4096);
     }
   }
 }
@@ -161,14 +81,14 @@ static void copy_dossier(uint8_t *map, struct inode *in, struct inode *in2, int
 static void copy_dossier_main(uint8_t *map, struct inode *in, struct inode *in2, int fd)
 {
   int32_t new_block = alloc_data_block(map);
-  lock_block(fd, new_block * 4096, F_WRLCK);
+  lock_block(fd, (int64_t)new_block * 4096, F_WRLCK);
   struct inode *dossier = get_inode(map, new_block);
   dossier->profondeur = TO_LE32(FROM_LE32(in2->profondeur) + 1);
   init_inode(dossier, in->filename, true);
   copy_dossier(map, in, dossier, fd);
-  add_inode(in2, new_block);
-  calcul_sha1(dossier, 4000, dossier->sha1);
-  unlock_block(fd, new_block * 4096);
+  add_inode(map, in2, new_block);
+  update_block_sha1(dossier);
+  unlock_block(fd, (int64_t)new_block * 4096);
 }
 
 static void copy_fichier_vers_externe(uint8_t *map, struct inode *in, const char *filename)
@@ -180,76 +100,39 @@ static void copy_fichier_vers_externe(uint8_t *map, struct inode *in, const char
     return;
   }
 
-  uint32_t file_size = FROM_LE32(in->file_size);
-  uint32_t bytes_written = 0;
+  uint64_t file_size = inode_size(in);
+  uint64_t bytes_written = 0;
 
-  // Copier les blocs directs
-  for (int i = 0; i < 900 && bytes_written < file_size; i++)
+  // Copier les blocs du fichier, directs puis simple ou double indirection ;
+  // les trous sont sautés, le fichier externe reste creux
+  struct block_iter it;
+  block_iter_init(&it, map, in);
+  int32_t blk, n;
+  while (bytes_written < file_size && (n = block_iter_next_run(&it, &blk)) > 0)
   {
-    int32_t blk = FROM_LE32(in->direct_blocks[i]);
-    if (blk == -1)
+    if ((uint64_t)it.run_pos * 4000 >= file_size)
       break;
-    struct data_block *db = get_data_block(map, blk);
-    uint32_t to_write = (file_size - bytes_written > 4000) ? 4000 : (file_size - bytes_written);
-    if (write(fd, db->data, to_write) != to_write)
+    if ((uint64_t)it.run_pos * 4000 != bytes_written)
     {
-      perror("Erreur d'écriture dans le fichier externe");
-      close(fd);
-      return;
+      bytes_written = (uint64_t)it.run_pos * 4000;
+      lseek(fd, bytes_written, SEEK_SET);
     }
-    bytes_written += to_write;
-  }
-
-  // Copier les blocs indirects/double indirects si besoin
-  if (bytes_written < file_size && (int32_t)FROM_LE32(in->double_indirect_block) != -1)
-  {
-    struct address_block *dbl = get_address_block(map, FROM_LE32(in->double_indirect_block));
-    if (FROM_LE32(dbl->type) == 6)
+    for (int32_t k = 0; k < n && bytes_written < file_size; k++)
     {
-      // Simple indirect
-      for (int i = 0; i < 1000 && bytes_written < file_size; i++)
+      struct data_block *db = get_data_block(map, blk + k);
+      uint32_t to_write = (file_size - bytes_written > 4000) ? 4000 : (file_size - bytes_written);
+      if (write(fd, db->data, to_write) != (ssize_t)to_write)
       {
-        int32_t blk = FROM_LE32(dbl->addresses[i]);
-        if (blk == -1)
-          break;
-        struct data_block *db = get_data_block(map, blk);
-        uint32_t to_write = (file_size - bytes_written > 4000) ? 4000 : (file_size - bytes_written);
-        if (write(fd, db->data, to_write) != to_write)
-        {
-          perror("Erreur d'écriture dans le fichier externe");
-          close(fd);
-          return;
-        }
-        bytes_written += to_write;
-      }
-    }
-    else
-    {
-      // Double indirect
-      for (int i = 0; i < 1000 && bytes_written < file_size; i++)
-      {
-        int32_t sib_blk = FROM_LE32(dbl->addresses[i]);
-        if (sib_blk == -1)
-          break;
-        struct address_block *sib = get_address_block(map, sib_blk);
-        for (int j = 0; j < 1000 && bytes_written < file_size; j++)
-        {
-          int32_t blk = FROM_LE32(sib->addresses[j]);
-          if (blk == -1)
-            break;
-          struct data_block *db = get_data_block(map, blk);
-          uint32_t to_write = (file_size - bytes_written > 4000) ? 4000 : (file_size - bytes_written);
-          if (write(fd, db->data, to_write) != to_write)
-          {
-            perror("Erreur d'écriture dans le fichier externe");
-            close(fd);
-            return;
-          }
-          bytes_written += to_write;
-        }
+        perror("Erreur d'écriture dans le fichier externe");
+        close(fd);
+        return;
       }
+      bytes_written += to_write;
     }
   }
+  // Trou final : la taille est donnée par ftruncate
+  if (bytes_written < file_size && ftruncate(fd, file_size) < 0)
+    perror("Erreur d'écriture dans le fichier externe");
   close(fd);
 }
 
@@ -262,11 +145,11 @@ static void copy_dossier_vers_externe(uint8_t *map, struct inode *in, const char
     return;
   }
   char path[512];
-  for (int i = 0; i < 900; i++)
+  struct dir_iter it;
+  dir_iter_init(&it, map, in);
+  int32_t child_idx;
+  while ((child_idx = dir_iter_next(&it)) >= 0)
   {
-    int32_t child_idx = FROM_LE32(in->direct_blocks[i]);
-    if (child_idx == -1)
-      continue;
     struct inode *child = get_inode(map, child_idx);
 
     snprintf(path, sizeof(path), "%s/%s", dirname, child->filename);
@@ -309,7 +192,9 @@ static void copy_fichier_vers_interne(uint8_t *map, struct inode *in, const char
 
   char buf[4000];
   size_t r;
-  uint32_t total = 0;
+  uint64_t total = 0;
+  // Taille connue : tous les blocs sont alloués d'un coup, contigus si possible
+  reserve_for_fd(map, in, fd);
 
   while ((r = read(fd, buf, 4000)) > 0)
   {
@@ -323,13 +208,13 @@ static void copy_fichier_vers_interne(uint8_t *map, struct inode *in, const char
     struct data_block *db = get_data_block(map, b);
     memset(db->data, 0, sizeof(db->data));
     memcpy(db->data, buf, r);
-    calcul_sha1(db->data, 4000, db->sha1);
+    update_block_sha1(db);
     db->type = TO_LE32(5);
     total += r;
-    in->file_size = TO_LE32(total);
+    set_inode_size(in, total);
   }
   in->modification_time = TO_LE32(time(NULL));
-  calcul_sha1(in, 4000, in->sha1);
+  update_block_sha1(in);
 
   close(fd);
 }
@@ -366,7 +251,7 @@ static void copy_dossier_vers_interne(uint8_t *map, struct inode *in, const char
       struct inode *new_dir = get_inode(map, new_blk);
       init_inode(new_dir, entry->d_name, true);
       new_dir->profondeur = TO_LE32(FROM_LE32(in->profondeur) + 1);
-      add_inode(in, new_blk);
+      add_inode(map, in, new_blk);
       copy_dossier_vers_interne(map, new_dir, path);
     }
     else if (S_ISREG(st.st_mode))
@@ -376,7 +261,7 @@ static void copy_dossier_vers_interne(uint8_t *map, struct inode *in, const char
       struct inode *new_file = get_inode(map, new_blk);
       init_inode(new_file, entry->d_name, false);
       new_file->profondeur = TO_LE32(FROM_LE32(in->profondeur) + 1);
-      add_inode(in, new_blk);
+      add_inode(map, in, new_blk);
       copy_fichier_vers_interne(map, new_file, path);
     }
   }
@@ -387,7 +272,7 @@ int cmd_cp(const char *fsname, const char *filename1, const char *filename2, boo
 {
   uint8_t *map;
   size_t size;
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs(fsname, &map, &size, ACCESS_SEQUENTIAL);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -637,5 +522,6 @@ int cmd_cp(const char *fsname, const char *filename1, const char *filename2, boo
       copy_interne_main(map, in, in2, fd);
     }
   }
+  close_fs(fd, map, size);
   return 0;
 }
\ No newline at end of file
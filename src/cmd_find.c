@@ -7,7 +7,7 @@ int cmd_find(const char *fsname, const char *type, const char *name, int days, c
   uint8_t *map;
   size_t size;
   // Ouvre le système de fichiers et mappe son contenu en mémoire
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs_ro(fsname, &map, &size, ACCESS_RANDOM);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -16,6 +16,7 @@ int cmd_find(const char *fsname, const char *type, const char *name, int days, c
   get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
 
   time_t now = time(NULL);
+  int32_t root = get_root_inode(map);
 
   // Parcours de tous les inodes
   for (int i = 0; i < nbi; i++)
@@ -23,9 +24,11 @@ int cmd_find(const char *fsname, const char *type, const char *name, int days, c
     struct inode *in = get_inode(map, 1 + nb1 + i);
     if (!(FROM_LE32(in->flags) & 1)) // Ignorer les inodes non allouées (bit 0)
       continue;
+    if (1 + nb1 + i == root) // La racine n'a pas de nom
+      continue;
 
     // Verrouille l'inode en lecture
-    int inode_offset = (1 + nb1) * 4096 + (int64_t)(in - (struct inode *)map);
+    int64_t inode_offset = block_offset_of(map, in);
     if (lock_block(fd, inode_offset, F_RDLCK) < 0)
     {
       print_error("Erreur lors du verrouillage de l'inode");
@@ -77,8 +80,10 @@ int cmd_find(const char *fsname, const char *type, const char *name, int days, c
       }
     }
 
-    // Affiche le nom du fichier/dossier correspondant
-    printf("%s\n", in->filename);
+    // Affiche le chemin complet du fichier/dossier correspondant
+    char path[1024];
+    inode_path(map, 1 + nb1 + i, path, sizeof(path));
+    printf("%s\n", path);
 
     // Déverrouille l'inode
     unlock_block(fd, inode_offset);
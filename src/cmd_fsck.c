@@ -1,174 +1,494 @@
 #include "../include/structures.h"
 #include "../include/utilitaires.h"
+#include "../include/index_dossier.h"
+#include <stdatomic.h>
 
-#define NB_THREADS 6
+// Nombre de blocs réclamés d'un coup par un thread, et taille des lots de SHA1
+#define FSCK_CHUNK 512
+#define FSCK_SHA1_BATCH 64
+#define FSCK_MAX_THREADS 64
 
-// Fonction principale de vérification et correction du système de fichiers (fsck)
-int cmd_fsck(const char *fsname)
+// Plage de blocs attribuée à un thread ; les autres peuvent y voler des morceaux
+struct fsck_range
 {
-  // Initialisation de la file de tâches SHA1 et des threads de vérification
-  sha1_queue_t queue = {.head = 0, .tail = 0, .done = 0, .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
-  pthread_t threads[NB_THREADS];
-  for (int i = 0; i < NB_THREADS; i++)
-    pthread_create(&threads[i], NULL, sha1_worker, &queue);
+  _Atomic int64_t next;
+  int64_t end;
+} __attribute__((aligned(64)));
 
+struct fsck_ctx
+{
   uint8_t *map;
-  size_t size;
-  // Ouvre le système de fichiers et mappe son contenu en mémoire
-  int fd = open_fs(fsname, &map, &size);
-  if (fd < 0)
-    return print_error("Erreur lors de l'ouverture du système de fichiers");
+  int32_t nb1, nbi, nbb;
+  int nthreads;
+  bool release; // Pages de chaque morceau vérifié rendues au noyau
+  struct fsck_range ranges[FSCK_MAX_THREADS];
+  pthread_mutex_t mutex; // Recalcul des SHA1 après la remise à zéro des locks (rare)
+};
 
-  int32_t nb1, nbi, nba, nbb;
-  // Récupère les informations sur la structure du conteneur
-  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
-  struct pignoufs *sb = (struct pignoufs *)map;
+// Nature d'une anomalie, dans l'ordre du rapport pour un même bloc
+enum fsck_kind
+{
+  FSCK_TYPE,        // Type de bloc incorrect pour sa zone
+  FSCK_ADDR_TYPE,   // Bloc d'adresses référencé par un inode de type incorrect
+  FSCK_OUT_OF_RANGE, // Référence vers un bloc hors du conteneur
+  FSCK_UNALLOCATED, // Bloc utilisé mais libre dans le bitmap
+  FSCK_EXTENT,      // Extents d'un inode vides, hors d'ordre ou qui se chevauchent
+  FSCK_ROOT,        // Inode racine du superbloc absent ou qui n'est pas un répertoire
+  FSCK_SHA1         // SHA1 stocké différent du contenu
+};
 
-  // Vérifie la magie du système de fichiers
-  if (strncmp(sb->magic, "pignoufs", 8) != 0)
+static const char *fsck_kind_names[] = {"type", "type_adresses", "hors_conteneur", "non_alloue", "extent", "racine", "sha1"};
+
+// Anomalie relevée par un thread : bloc concerné, son type, et bloc référencé ou SHA1 selon le cas
+struct fsck_issue
+{
+  int32_t block;
+  int32_t type;
+  int32_t kind;
+  int32_t ref;
+  uint8_t sha1_ref[20];
+  uint8_t sha1_calc[20];
+};
+
+// Chaque thread remplit son propre tableau d'anomalies, fusionné à la fin (aucun partage)
+struct fsck_worker
+{
+  struct fsck_ctx *ctx;
+  int id;
+  struct fsck_issue *issues;
+  int64_t count, capacity;
+};
+
+static struct fsck_issue *fsck_push(struct fsck_worker *w, int32_t block, enum fsck_kind kind, int32_t ref)
+{
+  if (w->count == w->capacity)
   {
-    print_error("Erreur: le conteneur n'est pas un système de fichiers Pignoufs");
-    close_fs(fd, map, size);
-    return 1;
+    int64_t cap = w->capacity ? w->capacity * 2 : 64;
+    struct fsck_issue *p = realloc(w->issues, cap * sizeof(*p));
+    if (!p)
+      fatal_error("Erreur: mémoire insuffisante pour le rapport de fsck");
+    w->issues = p;
+    w->capacity = cap;
   }
+  struct fsck_issue *is = &w->issues[w->count++];
+  memset(is, 0, sizeof(*is));
+  is->block = block;
+  is->type = FROM_LE32(*(const int32_t *)(w->ctx->map + (int64_t)block * 4096 + 4020));
+  is->kind = kind;
+  is->ref = ref;
+  return is;
+}
 
-  // Parcours de tous les blocs du système de fichiers
-  for (int32_t i = 1; i < nbb; i++)
+// Lecture directe du bitmap : les helpers d'accès tiennent un cache qui n'est pas partagé entre threads
+static bool fsck_bit_used(const struct fsck_ctx *ctx, int32_t b)
+{
+  const struct bitmap_block *bb = (const struct bitmap_block *)(ctx->map + (int64_t)(b / 32000 + 1) * 4096);
+  int32_t bit = b % 32000;
+  return (bb->bits[bit / 8] & (1 << (bit % 8))) == 0;
+}
+
+// Vérifie qu'un bloc référencé par l'inode i existe et est alloué
+static bool fsck_check_ref(struct fsck_worker *w, int32_t i, int32_t b)
+{
+  if (b < 0 || b >= w->ctx->nbb)
+  {
+    fsck_push(w, i, FSCK_OUT_OF_RANGE, b);
+    return false;
+  }
+  if (!fsck_bit_used(w->ctx, b))
   {
-    struct bitmap_block *bb = (struct bitmap_block *)((uint8_t *)map + (int64_t)(i) * 4096);
-    if (i <= nb1)
+    fsck_push(w, i, FSCK_UNALLOCATED, b);
+    return false;
+  }
+  return true;
+}
+
+// Vérifie un bloc d'adresses de l'inode i et tout ce qu'il référence : type 10 (triple) vers des
+// blocs de type 7, type 7 (double) vers des pages de type 6, type 6 vers des blocs de données.
+// expected vaut 0 pour le bloc d'indirection de l'inode, de type 6 ou 7. Faux à la première anomalie
+static bool fsck_check_addr(struct fsck_worker *w, int32_t i, int32_t b, int32_t expected)
+{
+  if (!fsck_check_ref(w, i, b))
+    return false;
+  const struct address_block *ab = (const struct address_block *)(w->ctx->map + (int64_t)b * 4096);
+  int32_t type = FROM_LE32(ab->type);
+  if (expected ? type != expected : type != 6 && type != 7)
+  {
+    fsck_push(w, i, FSCK_ADDR_TYPE, b);
+    return false;
+  }
+  for (int j = 0; j < 1000; j++)
+  {
+    int32_t c = FROM_LE32(ab->addresses[j]);
+    if (c < 0)
+      continue;
+    if (!(type == 6 ? fsck_check_ref(w, i, c) : fsck_check_addr(w, i, c, type == 10 ? 7 : 6)))
+      return false;
+  }
+  return true;
+}
+
+// Vérifie les blocs d'un inode alloué (on s'arrête à la première anomalie de l'inode)
+static void fsck_check_inode(struct fsck_worker *w, int32_t i, const struct inode *in)
+{
+  struct fsck_ctx *ctx = w->ctx;
+  // Vérifie que le bloc de l'inode est bien alloué dans le bitmap
+  if (!fsck_check_ref(w, i, i))
+    return;
+  // Fichier décrit par extents : séries triées et disjointes, blocs tous alloués
+  if (FROM_LE32(in->flags) & INODE_EXTENTS)
+  {
+    const struct extent *e = (const struct extent *)in->direct_blocks;
+    int64_t end = 0;
+    for (int j = 0; j < INODE_EXTENTS_MAX && (int32_t)FROM_LE32(e[j].length) > 0; j++)
     {
-      // Vérifie le type des blocs de bitmap
-      if (bb->type != TO_LE32(2))
+      int32_t logical = FROM_LE32(e[j].logical), start = FROM_LE32(e[j].start);
+      if (logical < end)
       {
-        print_error("Erreur: bloc de bitmap a un type incorrect");
-        close_fs(fd, map, size);
-        return 1;
+        fsck_push(w, i, FSCK_EXTENT, start);
+        return;
       }
+      end = (int64_t)logical + (int32_t)FROM_LE32(e[j].length);
+      for (int64_t b = start; b < start + (end - logical); b++)
+        if (!fsck_check_ref(w, i, (int32_t)b))
+          return;
     }
-    else if (i <= nb1 + nbi)
+    return;
+  }
+  // Vérifie tous les blocs directs de l'inode
+  for (int j = 0; j < 900; j++)
+  {
+    int32_t b = FROM_LE32(in->direct_blocks[j]);
+    if (b < 0)
+      continue; // Trou (fichier creux) ou case libre
+    if (!fsck_check_ref(w, i, b))
+      return;
+  }
+  // Index des noms d'un répertoire : en-tête et blocs de cases
+  int32_t idx = FROM_LE32(in->dir_index);
+  if (idx > 0)
+  {
+    if (!fsck_check_ref(w, i, idx))
+      return;
+    const struct dir_index_block *h = (const struct dir_index_block *)(ctx->map + (int64_t)idx * 4096);
+    int32_t k = FROM_LE32(h->nb_slot_blocks);
+    if (FROM_LE32(h->type) != 8 || k < 1 || k > DIR_INDEX_MAX_BLOCKS)
     {
-      // Vérifie le type des blocs d'inode
-      if (bb->type != TO_LE32(3))
+      fsck_push(w, i, FSCK_ADDR_TYPE, idx);
+      return;
+    }
+    // Grand index : pages d'adresses des blocs de cases
+    for (int32_t p = 0; k > DIR_INDEX_DIRECT && p < (k + 999) / 1000; p++)
+    {
+      int32_t pb = FROM_LE32(h->slot_blocks[p]);
+      if (!fsck_check_ref(w, i, pb))
+        return;
+      if (FROM_LE32(((const struct address_block *)(ctx->map + (int64_t)pb * 4096))->type) != 6)
       {
-        print_error("Erreur: bloc d'inode a un type incorrect");
-        close_fs(fd, map, size);
-        return 1;
+        fsck_push(w, i, FSCK_ADDR_TYPE, pb);
+        return;
       }
-      struct inode *in = (struct inode *)bb;
-      if (in->flags & 1) // Si l'inode est allouée
+    }
+    for (int32_t j = 0; j < k; j++)
+    {
+      int32_t sb;
+      if (k <= DIR_INDEX_DIRECT)
+        sb = FROM_LE32(h->slot_blocks[j]);
+      else
+        sb = FROM_LE32(((const struct address_block *)(ctx->map + (int64_t)FROM_LE32(h->slot_blocks[j / 1000]) * 4096))
+                           ->addresses[j % 1000]);
+      if (!fsck_check_ref(w, i, sb))
+        return;
+      if (FROM_LE32(((const struct address_block *)(ctx->map + (int64_t)sb * 4096))->type) != 9)
       {
-        // Vérifie que le bloc de l'inode est bien alloué dans le bitmap
-        if (!check_bitmap_bit(map, i))
-        {
-          print_error("Erreur: inode a un bloc de données non alloué");
-          close_fs(fd, map, size);
-          return 1;
-        }
-        // Réinitialise les locks sur l'inode
-        in->flags &= ~(1 << 3);
-        in->flags &= ~(1 << 4);
-        // Vérifie tous les blocs directs de l'inode
-        for (int j = 0; j < 900; j++)
-        {
-          int32_t b = FROM_LE32(in->direct_blocks[j]);
-          if (b < 0)
-            break;
-          if (!check_bitmap_bit(map, b))
-          {
-            print_error("Erreur: inode a un bloc de données non alloué");
-            close_fs(fd, map, size);
-            return 1;
-          }
-        }
-        // Vérifie les blocs indirects/double indirects si présents
-        if ((int32_t)FROM_LE32(in->double_indirect_block) >= 0)
-        {
-          struct address_block *dbl = get_address_block(map, FROM_LE32(in->double_indirect_block));
-          if (FROM_LE32(dbl->type) == 6)
-          {
-            // Simple indirect
-            for (int j = 0; j < 1000; j++)
-            {
-              int32_t db = FROM_LE32(dbl->addresses[j]);
-              if (db < 0)
-                break;
-              if (!check_bitmap_bit(map, db))
-              {
-                print_error("Erreur: inode a un bloc de données indirect non alloué");
-                close_fs(fd, map, size);
-                return 1;
-              }
-            }
-          }
-          else
-          {
-            // Double indirect
-            for (int j = 0; j < 1000; j++)
-            {
-              int32_t db = FROM_LE32(dbl->addresses[j]);
-              if (db < 0)
-                break;
-              struct address_block *sib = get_address_block(map, db);
-              for (int k = 0; k < 1000; k++)
-              {
-                int32_t db2 = FROM_LE32(sib->addresses[k]);
-                if (db2 < 0)
-                  break;
-                if (!check_bitmap_bit(map, db2))
-                {
-                  print_error("Erreur: inode a un bloc de données indirect non alloué");
-                  close_fs(fd, map, size);
-                  return 1;
-                }
-              }
-            }
-          }
-        }
+        fsck_push(w, i, FSCK_ADDR_TYPE, sb);
+        return;
       }
     }
-    else
+  }
+  // Vérifie les blocs indirects/double indirects, puis l'indirection triple, si présents
+  int32_t ind = FROM_LE32(in->double_indirect_block);
+  if (ind >= 0 && !fsck_check_addr(w, i, ind, 0))
+    return;
+  int32_t tri = FROM_LE32(in->triple_indirect_block);
+  if (tri > 0)
+    fsck_check_addr(w, i, tri, 10);
+}
+
+// Type attendu selon la zone : superbloc, bitmap, inodes, puis données (4 à 10)
+static bool fsck_type_ok(const struct fsck_ctx *ctx, int32_t i, int32_t type)
+{
+  if (i == 0)
+    return type == 1;
+  if (i <= ctx->nb1)
+    return type == 2;
+  if (i <= ctx->nb1 + ctx->nbi)
+    return type == 3;
+  return type >= 4 && type <= 10;
+}
+
+// L'inode racine annoncé par le superbloc doit être un répertoire alloué de la zone d'inodes
+static void fsck_check_root(struct fsck_worker *w)
+{
+  struct fsck_ctx *ctx = w->ctx;
+  const struct pignoufs *sb = (const struct pignoufs *)ctx->map;
+  if (!(FROM_LE32(sb->features) & PFS_FEATURE_ROOT))
+    return;
+  int32_t root = FROM_LE32(sb->root_inode);
+  if (root <= ctx->nb1 || root > ctx->nb1 + ctx->nbi)
+  {
+    fsck_push(w, 0, FSCK_ROOT, root);
+    return;
+  }
+  const struct inode *in = (const struct inode *)(ctx->map + (int64_t)root * 4096);
+  uint32_t flags = FROM_LE32(in->flags);
+  if (!(flags & 1) || !((flags >> 5) & 1))
+    fsck_push(w, 0, FSCK_ROOT, root);
+}
+
+// Vérifie le type d'un bloc selon sa zone, et les références d'un inode alloué
+static void fsck_check_block(struct fsck_worker *w, int32_t i)
+{
+  struct fsck_ctx *ctx = w->ctx;
+  const struct inode *in = (const struct inode *)(ctx->map + (int64_t)i * 4096);
+  if (!fsck_type_ok(ctx, i, FROM_LE32(in->type)))
+  {
+    fsck_push(w, i, FSCK_TYPE, -1);
+    return;
+  }
+  if (i == 0)
+    fsck_check_root(w);
+  if (i > ctx->nb1 && i <= ctx->nb1 + ctx->nbi && (FROM_LE32(in->flags) & 1))
+    fsck_check_inode(w, i, in);
+}
+
+// Vérifie un morceau de blocs : structure, puis SHA1 par lots
+static void fsck_chunk(struct fsck_worker *w, int32_t start, int32_t end)
+{
+  struct fsck_ctx *ctx = w->ctx;
+  const void *data[FSCK_SHA1_BATCH];
+  uint8_t sha1[FSCK_SHA1_BATCH][20];
+  uint8_t *out[FSCK_SHA1_BATCH];
+  for (int k = 0; k < FSCK_SHA1_BATCH; k++)
+    out[k] = sha1[k];
+
+  for (int32_t b = start; b < end; b += FSCK_SHA1_BATCH)
+  {
+    int n = (end - b < FSCK_SHA1_BATCH) ? end - b : FSCK_SHA1_BATCH;
+    for (int k = 0; k < n; k++)
     {
-      // Vérifie le type des blocs de données
-      if (bb->type < TO_LE32(4) || bb->type > TO_LE32(7))
+      fsck_check_block(w, b + k);
+      data[k] = ctx->map + (int64_t)(b + k) * 4096;
+    }
+    calcul_sha1_many(data, n, 4000, out);
+    for (int k = 0; k < n; k++)
+    {
+      const uint8_t *blk = data[k];
+      if (memcmp(sha1[k], blk + 4000, 20) != 0)
+      {
+        struct fsck_issue *is = fsck_push(w, b + k, FSCK_SHA1, -1);
+        memcpy(is->sha1_ref, blk + 4000, 20);
+        memcpy(is->sha1_calc, sha1[k], 20);
+      }
+    }
+
+    // Réinitialise les locks restés sur les inodes (après la vérification du SHA1 d'origine)
+    for (int k = 0; k < n; k++)
+    {
+      int32_t i = b + k;
+      if (i <= ctx->nb1 || i > ctx->nb1 + ctx->nbi)
+        continue;
+      struct inode *in = (struct inode *)(ctx->map + (int64_t)i * 4096);
+      if ((FROM_LE32(in->flags) & 1) && (FROM_LE32(in->flags) & ((1 << 3) | (1 << 4))))
       {
-        print_error("Erreur: bloc de données a un type incorrect");
-        close_fs(fd, map, size);
-        return 1;
+        in->flags &= ~TO_LE32((1 << 3) | (1 << 4));
+        pthread_mutex_lock(&ctx->mutex);
+        update_block_sha1(in);
+        pthread_mutex_unlock(&ctx->mutex);
       }
     }
+  }
+}
+
+// Réclame un morceau dans une plage ; retourne false si elle est épuisée
+static bool fsck_claim(struct fsck_range *r, int32_t *start, int32_t *end)
+{
+  if (atomic_load_explicit(&r->next, memory_order_relaxed) >= r->end)
+    return false;
+  int64_t s = atomic_fetch_add_explicit(&r->next, FSCK_CHUNK, memory_order_relaxed);
+  if (s >= r->end)
+    return false;
+  *start = (int32_t)s;
+  *end = (int32_t)(s + FSCK_CHUNK < r->end ? s + FSCK_CHUNK : r->end);
+  return true;
+}
+
+// Thread de vérification : sa propre plage d'abord, puis vol de morceaux dans les autres
+static void *fsck_worker(void *arg)
+{
+  struct fsck_worker *w = arg;
+  struct fsck_ctx *ctx = w->ctx;
+  int32_t start, end;
+  for (int k = 0; k < ctx->nthreads; k++)
+  {
+    struct fsck_range *r = &ctx->ranges[(w->id + k) % ctx->nthreads];
+    while (fsck_claim(r, &start, &end))
+    {
+      fsck_chunk(w, start, end);
+      // Morceau vérifié : ses pages sont rendues (le bitmap, relu pour chaque inode, reste chargé)
+      if (ctx->release && start > ctx->nb1)
+        madvise(ctx->map + (int64_t)start * 4096, (size_t)(end - start) * 4096, MADV_DONTNEED);
+    }
+  }
+  return NULL;
+}
+
+static int fsck_issue_cmp(const void *a, const void *b)
+{
+  const struct fsck_issue *x = a, *y = b;
+  if (x->block != y->block)
+    return x->block < y->block ? -1 : 1;
+  return x->kind - y->kind;
+}
+
+static void print_sha1_hex(const uint8_t *sha1)
+{
+  for (int i = 0; i < 20; i++)
+    printf("%02x", sha1[i]);
+}
+
+// Fusionne les anomalies des threads, les trie par bloc et affiche le rapport
+// Format ligne par ligne, destiné à être analysé :
+//   fsck: bloc=<n> zone=<zone> type=<t> anomalie=<nature> [ref=<bloc>] [attendu=<sha1> calcule=<sha1>]
+//   fsck: zone=<zone> blocs=<n> anomalies=<n>
+// Retourne le nombre total d'anomalies
+static int64_t fsck_report(const struct fsck_ctx *ctx, struct fsck_worker *workers, int nworkers)
+{
+  static const char *zones[] = {"superbloc", "bitmap", "inodes", "donnees"};
+  int64_t zone_blocks[4] = {1, ctx->nb1, ctx->nbi, ctx->nbb - 1 - ctx->nb1 - ctx->nbi};
+  int64_t zone_issues[4] = {0, 0, 0, 0};
 
-    // Déverrouille le bloc après vérification
-    unlock_block(fd, i * 4096);
-
-    // Ajoute une tâche SHA1 à la file pour vérification asynchrone
-    pthread_mutex_lock(&queue.mutex);
-    int next = (queue.tail + 1) % SHA1_QUEUE_SIZE;
-    while (next == queue.head)
-    { // queue pleine
-      pthread_mutex_unlock(&queue.mutex);
-      sched_yield();
-      pthread_mutex_lock(&queue.mutex);
-      next = (queue.tail + 1) % SHA1_QUEUE_SIZE;
+  int64_t total = 0;
+  for (int t = 0; t < nworkers; t++)
+    total += workers[t].count;
+  struct fsck_issue *all = total ? malloc(total * sizeof(*all)) : NULL;
+  if (total && !all)
+    fatal_error("Erreur: mémoire insuffisante pour le rapport de fsck");
+  int64_t n = 0;
+  for (int t = 0; t < nworkers; t++)
+  {
+    if (workers[t].count)
+      memcpy(all + n, workers[t].issues, workers[t].count * sizeof(*all));
+    n += workers[t].count;
+  }
+  if (total)
+    qsort(all, total, sizeof(*all), fsck_issue_cmp);
+
+  for (int64_t k = 0; k < total; k++)
+  {
+    const struct fsck_issue *is = &all[k];
+    int z = is->block == 0 ? 0 : is->block <= ctx->nb1 ? 1 : is->block <= ctx->nb1 + ctx->nbi ? 2 : 3;
+    zone_issues[z]++;
+    printf("fsck: bloc=%d zone=%s type=%d anomalie=%s", is->block, zones[z], is->type, fsck_kind_names[is->kind]);
+    if (is->kind == FSCK_SHA1)
+    {
+      printf(" attendu=");
+      print_sha1_hex(is->sha1_ref);
+      printf(" calcule=");
+      print_sha1_hex(is->sha1_calc);
     }
-    queue.tasks[queue.tail] = (sha1_task_t){.data = bb, .len = 4000, .block_num = i, .block_type = bb->type};
-    memcpy(queue.tasks[queue.tail].sha1_ref, bb->sha1, 20);
-    queue.tail = next;
-    pthread_cond_signal(&queue.cond);
-    pthread_mutex_unlock(&queue.mutex);
+    else if (is->kind != FSCK_TYPE)
+      printf(" ref=%d", is->ref);
+    printf("\n");
+  }
+  for (int z = 0; z < 4; z++)
+    printf("fsck: zone=%s blocs=%ld anomalies=%ld\n", zones[z], (long)zone_blocks[z], (long)zone_issues[z]);
+  free(all);
+  return total;
+}
+
+// Fonction principale de vérification et correction du système de fichiers (fsck)
+int cmd_fsck(const char *fsname)
+{
+  uint8_t *map;
+  size_t size;
+  // Ouvre le système de fichiers et mappe son contenu en mémoire
+  int fd = open_fs(fsname, &map, &size, ACCESS_SCAN);
+  if (fd < 0)
+    return print_error("Erreur lors de l'ouverture du système de fichiers");
+
+  // fsck vérifie lui-même chaque SHA1 : pas de vérification supplémentaire par les helpers
+  enum verify_policy policy = get_verify_policy();
+  set_verify_policy(VERIFY_FSCK_ONLY);
+
+  int32_t nb1, nbi, nba, nbb;
+  // Récupère les informations sur la structure du conteneur
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  struct pignoufs *sb = (struct pignoufs *)map;
+
+  // Vérifie la magie du système de fichiers
+  if (strncmp(sb->magic, "pignoufs", 8) != 0)
+  {
+    print_error("Erreur: le conteneur n'est pas un système de fichiers Pignoufs");
+    close_fs(fd, map, size);
+    set_verify_policy(policy);
+    return 1;
   }
+  if (nbb <= 0 || (int64_t)nbb * 4096 > (int64_t)size || nb1 + nbi >= nbb)
+  {
+    print_error("Erreur: superbloc incohérent avec la taille du conteneur");
+    close_fs(fd, map, size);
+    set_verify_policy(policy);
+    return 1;
+  }
+
+  // Autant de threads que de cœurs, sans dépasser un thread par morceau
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  int nthreads = ncpu > 0 ? (int)ncpu : 1;
+  if (nthreads > FSCK_MAX_THREADS)
+    nthreads = FSCK_MAX_THREADS;
+  if (nthreads > (nbb + FSCK_CHUNK - 1) / FSCK_CHUNK)
+    nthreads = (nbb + FSCK_CHUNK - 1) / FSCK_CHUNK;
 
-  // Signale la fin des tâches SHA1 aux threads
-  pthread_mutex_lock(&queue.mutex);
-  queue.done = 1;
-  pthread_cond_broadcast(&queue.cond);
-  pthread_mutex_unlock(&queue.mutex);
+  struct fsck_ctx ctx;
+  ctx.map = map;
+  ctx.nb1 = nb1;
+  ctx.nbi = nbi;
+  ctx.nbb = nbb;
+  ctx.nthreads = nthreads;
+  // Parcours unique (profil scan, par défaut) ou mémoire bornée par --resident : rien n'est gardé chargé
+  ctx.release = resident_limited() || effective_access_profile(ACCESS_SCAN) == ACCESS_SCAN;
+  pthread_mutex_init(&ctx.mutex, NULL);
+  // Découpage des blocs en plages contiguës, une par thread
+  for (int t = 0; t < nthreads; t++)
+  {
+    atomic_init(&ctx.ranges[t].next, (int64_t)nbb * t / nthreads);
+    ctx.ranges[t].end = (int64_t)nbb * (t + 1) / nthreads;
+  }
+
+  pthread_t threads[FSCK_MAX_THREADS];
+  struct fsck_worker workers[FSCK_MAX_THREADS];
+  for (int t = 0; t < nthreads; t++)
+    workers[t] = (struct fsck_worker){.ctx = &ctx, .id = t};
+  int started = 0;
+  for (int t = 1; t < nthreads; t++)
+  {
+    if (pthread_create(&threads[t], NULL, fsck_worker, &workers[t]) != 0)
+      break; // Les plages restantes seront volées par les threads lancés
+    started = t;
+  }
+  // Le thread principal prend la plage 0
+  fsck_worker(&workers[0]);
+  for (int t = 1; t <= started; t++)
+    pthread_join(threads[t], NULL);
+  pthread_mutex_destroy(&ctx.mutex);
 
-  // Attend la fin de tous les threads SHA1
-  for (int i = 0; i < NB_THREADS; i++)
-    pthread_join(threads[i], NULL);
+  int64_t total = fsck_report(&ctx, workers, nthreads);
+  for (int t = 0; t < nthreads; t++)
+    free(workers[t].issues);
 
   // Ferme le système de fichiers
   close_fs(fd, map, size);
-  return 0;
-}
\ No newline at end of file
+  set_verify_policy(policy);
+  return total ? 1 : 0;
+}
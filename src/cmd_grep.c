@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // memmem
 #include "../include/structures.h"
 #include "../include/utilitaires.h"
 
@@ -7,7 +8,7 @@ int cmd_grep(const char *fsname, const char *pattern)
   uint8_t *map;
   size_t size;
   // Ouvre le système de fichiers et mappe son contenu en mémoire
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs_ro(fsname, &map, &size, ACCESS_SEQUENTIAL);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -15,6 +16,16 @@ int cmd_grep(const char *fsname, const char *pattern)
   // Récupère les informations sur la structure du conteneur
   get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
 
+  // Fenêtre de recherche : un bloc de données précédé de la fin du bloc précédent
+  size_t m = strlen(pattern);
+  uint8_t *window = malloc(m + 4000);
+  if (!window)
+  {
+    print_error("Erreur d'allocation mémoire");
+    close_fs(fd, map, size);
+    return 1;
+  }
+
   // Parcours de tous les inodes
   for (int i = 0; i < nbi; i++)
   {
@@ -27,53 +38,55 @@ int cmd_grep(const char *fsname, const char *pattern)
     if (!((FROM_LE32(in->flags) >> 1) & 1) || ((FROM_LE32(in->flags) >> 3) & 1) || ((FROM_LE32(in->flags) >> 4) & 1))
       continue;
 
-    // Lire le contenu du fichier interne
-    uint32_t file_size = FROM_LE32(in->file_size);
-    char *content = malloc(file_size + 1);
-    if (!content)
+    // Verrou en lecture sur l'inode pendant le parcours du contenu
+    int64_t inode_offset = block_offset_of(map, in);
+    if (lock_block(fd, inode_offset, F_RDLCK) < 0)
     {
-      print_error("Erreur d'allocation mémoire");
+      print_error("Erreur lors du verrouillage de l'inode");
+      free(window);
       close_fs(fd, map, size);
       return 1;
     }
 
-    uint32_t remaining_data = file_size;
-    char *ptr = content;
-
-    // Parcours des blocs directs pour lire le contenu
-    for (int j = 0; j < 900 && remaining_data > 0; j++)
+    // Parcours des blocs du fichier par séries, bloc par bloc à la suite des m - 1 derniers octets
+    // du bloc précédent (un motif à cheval sur deux blocs est trouvé). Le motif ne contient pas
+    // d'octet nul : il ne peut pas traverser un trou, qui remet la fenêtre à zéro
+    uint64_t file_size = inode_size(in);
+    bool found = m == 0;
+    size_t kept = 0;
+    int64_t next = 0; // Rang logique attendu du prochain bloc
+    struct block_iter it;
+    block_iter_init(&it, map, in);
+    int32_t b, n;
+    while (!found && (n = block_iter_next_run(&it, &b)) > 0 && (uint64_t)it.run_pos * 4000 < file_size)
     {
-      int32_t b = FROM_LE32(in->direct_blocks[j]);
-      if (b < 0)
-        break;
-
-      // Verrouille le bloc de données pour lecture
-      if (lock_block(fd, b * 4096, F_RDLCK) < 0)
+      if (it.run_pos != next)
+        kept = 0;
+      for (int32_t k = 0; k < n && !found; k++)
       {
-        print_error("Erreur lors du verrouillage du bloc de données");
-        free(content);
-        close_fs(fd, map, size);
-        return 1;
+        uint64_t pos = (uint64_t)(it.run_pos + k) * 4000;
+        if (pos >= file_size)
+          break;
+        uint32_t len = file_size - pos < 4000 ? file_size - pos : 4000;
+        memcpy(window + kept, get_data_block(map, b + k)->data, len);
+        size_t total = kept + len;
+        found = memmem(window, total, pattern, m) != NULL;
+        kept = total < m - 1 ? total : m - 1;
+        memmove(window, window + total - kept, kept);
       }
-
-      struct data_block *data_position = get_data_block(map, b);
-      uint32_t buffer = remaining_data < 4000 ? remaining_data : 4000;
-      memcpy(ptr, data_position->data, buffer);
-      ptr += buffer;
-      remaining_data -= buffer;
-
-      // Déverrouille le bloc de données
-      unlock_block(fd, b * 4096);
+      next = it.run_pos + n;
     }
-    content[file_size] = '\0';
-
-    // Recherche du motif dans le contenu du fichier
-    if (strstr(content, pattern) != NULL)
-      printf("%s\n", in->filename);
+    unlock_block(fd, inode_offset);
 
-    free(content);
+    if (found)
+    {
+      char path[1024];
+      inode_path(map, 1 + nb1 + i, path, sizeof(path));
+      printf("%s\n", path);
+    }
   }
 
+  free(window);
   // Ferme le système de fichiers
   close_fs(fd, map, size);
   return 0;
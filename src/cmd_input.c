@@ -5,7 +5,7 @@ int cmd_input(const char *fsname, const char *filename)
 {
   uint8_t *map;
   size_t size;
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs(fsname, &map, &size, ACCESS_SEQUENTIAL);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -23,6 +23,7 @@ int cmd_input(const char *fsname, const char *filename)
     if (val == -1)
     {
       val = create_file(map, dir_name);
+      add_root_entry(map, val);
     }
     in = get_inode(map, val);
   }
@@ -37,7 +38,7 @@ int cmd_input(const char *fsname, const char *filename)
       val = create_file(map, dir_name);
       struct inode *in2 = get_inode(map, val);
       in2->profondeur = TO_LE32(FROM_LE32(in->profondeur) + 1);
-      add_inode(in, val);
+      add_inode(map, in, val);
       in = in2;
     }
     else
@@ -49,7 +50,7 @@ int cmd_input(const char *fsname, const char *filename)
         val = create_file(map, dir_name);
         struct inode *in2 = get_inode(map, val);
         in2->profondeur = TO_LE32(FROM_LE32(in->profondeur) + 1);
-        add_inode(in, val);
+        add_inode(map, in, val);
         in = in2;
       }
       else
@@ -70,7 +71,7 @@ int cmd_input(const char *fsname, const char *filename)
   }
 
   // Verrouiller l'inode
-  int inode_offset = (1 + nb1) * 4096 + (int64_t)(in - (struct inode *)map);
+  int64_t inode_offset = block_offset_of(map, in);
   if (lock_block(fd, inode_offset, F_WRLCK) < 0)
   {
     print_error("Erreur lors du verrouillage de l'inode");
@@ -79,31 +80,23 @@ int cmd_input(const char *fsname, const char *filename)
   }
   char buf[4000];
   size_t r;
-  uint32_t total = FROM_LE32(in->file_size);
-  while ((r = read(STDIN_FILENO, buf, 4000)) > 0)
+  uint64_t total = inode_size(in);
+  // Taille connue (fichier régulier) : tous les blocs sont alloués d'un coup, contigus si possible
+  reserve_for_fd(map, in, STDIN_FILENO);
+  // Les blocs de données ne sont atteints que par l'inode verrouillé : pas de verrou par bloc, leurs
+  // SHA1 sont écrits en une fois quand l'inode est déverrouillé (même pour des lectures courtes d'un tube).
+  // Après une lecture courte, on ne lit que ce qui tient dans le dernier bloc entamé
+  while ((r = read(STDIN_FILENO, buf, 4000 - total % 4000)) > 0)
   {
     uint32_t offset = (total % 4000);
     if (offset > 0)
     {
       int32_t last = get_last_data_block(map, in);
       struct data_block *db = get_data_block(map, last);
-
-      // Verrouiller le bloc de données
-      int data_offset = last * 4096;
-      if (lock_block(fd, data_offset, F_WRLCK) < 0)
-      {
-        print_error("Erreur lors du verrouillage du bloc de données");
-        close_fs(fd, map, size);
-        return 1;
-      }
-
       memcpy(db->data + offset, buf, r);
-      calcul_sha1(db->data, 4000, db->sha1);
+      update_block_sha1(db);
       total += r;
-      in->file_size = TO_LE32(total);
-
-      // Déverrouiller le bloc de données
-      unlock_block(fd, data_offset);
+      set_inode_size(in, total);
     }
     else
     {
@@ -114,30 +107,17 @@ int cmd_input(const char *fsname, const char *filename)
         break;
       }
       struct data_block *db = get_data_block(map, b);
-
-      // Verrouiller le bloc de données
-      int data_offset = b * 4096;
-      if (lock_block(fd, data_offset, F_WRLCK) < 0)
-      {
-        print_error("Erreur lors du verrouillage du bloc de données");
-        close_fs(fd, map, size);
-        return 1;
-      }
-
       memset(db->data, 0, sizeof(db->data));
       memcpy(db->data, buf, r);
-      calcul_sha1(db->data, 4000, db->sha1);
+      update_block_sha1(db);
       db->type = TO_LE32(5);
       total += r;
-      in->file_size = TO_LE32(total);
-
-      // Déverrouiller le bloc de données
-      unlock_block(fd, data_offset);
+      set_inode_size(in, total);
     }
   }
-  in->file_size = TO_LE32(total);
+  set_inode_size(in, total);
   in->modification_time = TO_LE32(time(NULL));
-  calcul_sha1(in, 4000, in->sha1);
+  update_block_sha1(in);
 
   // Déverrouiller l'inode
   unlock_block(fd, inode_offset);
@@ -28,7 +28,7 @@ int cmd_lock(const char *fsname, const char *filename, const char *arg)
   uint8_t *map;
   size_t size;
   // Ouvre le système de fichiers et mappe son contenu en mémoire
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs(fsname, &map, &size, ACCESS_RANDOM);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -16,14 +16,44 @@ static void print_ls(struct inode *in)
   {
     strftime(buf, sizeof buf, "%Y-%m-%d %H:%M", tm);
   }
-  printf("%s %10u %s %s%s\n", perm, in->file_size, buf, in->filename, (((FROM_LE32(in->flags) >> 5) & 1) ? "/" : ""));
+  printf("%s %10llu %s %s%s\n", perm, (unsigned long long)inode_size(in), buf, in->filename, (((FROM_LE32(in->flags) >> 5) & 1) ? "/" : ""));
+}
+
+// Affiche une entrée, en format long avec -l
+static void print_entry(struct inode *in, const char *argument)
+{
+  if (argument != NULL)
+  {
+    if (strcmp(argument, "-l") == 0)
+    {
+      print_ls(in);
+    }
+  }
+  else
+  {
+    printf("%s%s\n", in->filename, ((FROM_LE32(in->flags) >> 5) & 1) ? "/" : "");
+  }
+}
+
+// Affiche les enfants d'un répertoire
+static void print_children(uint8_t *map, struct inode *in, const char *argument)
+{
+  struct dir_iter it;
+  dir_iter_init(&it, map, in);
+  int32_t child;
+  while ((child = dir_iter_next(&it)) >= 0)
+  {
+    struct inode *child_inode = get_inode(map, child);
+    if (child_inode->flags & 1)
+      print_entry(child_inode, argument);
+  }
 }
 
 int cmd_ls(const char *fsname, const char *filename, const char *argument)
 {
   uint8_t *map;
   size_t size;
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs_ro(fsname, &map, &size, ACCESS_RANDOM);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
   int32_t nb1, nbi, nba, nbb;
@@ -31,22 +61,17 @@ int cmd_ls(const char *fsname, const char *filename, const char *argument)
 
   if (filename == NULL)
   { // racine print
-    for (int i = 0; i < nbi; i++)
+    int32_t root = get_root_inode(map);
+    if (root >= 0)
+      print_children(map, get_inode(map, root), argument);
+    else
     {
-      struct inode *in = get_inode(map, 1 + nb1 + i);
-      if ((in->flags & 1) && FROM_LE32(in->profondeur) == 0)
+      // Ancien conteneur sans inode racine : entrées de profondeur 0
+      for (int i = 0; i < nbi; i++)
       {
-        if (argument != NULL)
-        {
-          if (strcmp(argument, "-l") == 0)
-          {
-            print_ls(in);
-          }
-        }
-        else
-        {
-          printf("%s%s\n", in->filename, ((FROM_LE32(in->flags) >> 5) & 1) ? "/" : "");
-        }
+        struct inode *in = get_inode(map, 1 + nb1 + i);
+        if ((in->flags & 1) && FROM_LE32(in->profondeur) == 0)
+          print_entry(in, argument);
       }
     }
   }
@@ -112,42 +137,12 @@ int cmd_ls(const char *fsname, const char *filename, const char *argument)
     // Si c'est un dossier, affiche son contenu
     if (FROM_LE32(in->flags >> 5) & 1)
     {
-      for (int i = 0; i < 900; i++)
-      {
-        if (in->direct_blocks[i] != -1)
-        {
-          struct inode *child_inode = get_inode(map, FROM_LE32(in->direct_blocks[i]));
-          if (child_inode->flags & 1)
-          {
-            if (argument != NULL)
-            {
-              if (strcmp(argument, "-l") == 0)
-              {
-                print_ls(child_inode);
-              }
-            }
-            else
-            {
-              printf("%s%s\n", child_inode->filename, ((FROM_LE32(child_inode->flags) >> 5) & 1) ? "/" : "");
-            }
-          }
-        }
-      }
+      print_children(map, in, argument);
     }
     else
     {
       // Sinon, affiche le fichier lui-même
-      if (argument != NULL)
-      {
-        if (strcmp(argument, "-l") == 0)
-        {
-          print_ls(in);
-        }
-      }
-      else
-      {
-        printf("%s%s\n", in->filename, ((FROM_LE32(in->flags) >> 5) & 1) ? "/" : "");
-      }
+      print_entry(in, argument);
     }
   }
 
@@ -1,5 +1,6 @@
 #include "../include/structures.h"
 #include "../include/utilitaires.h"
+#include "../include/cache_chemins.h"
 
 // Fonction pour créer un répertoire dans le système de fichiers interne
 int cmd_mkdir(const char *fsname, char *path)
@@ -7,7 +8,7 @@ int cmd_mkdir(const char *fsname, char *path)
   uint8_t *map;
   size_t size;
   // Ouvre le système de fichiers et mappe son contenu en mémoire
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs(fsname, &map, &size, ACCESS_RANDOM);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -21,6 +22,8 @@ int cmd_mkdir(const char *fsname, char *path)
     close_fs(fd, map, size);
     return print_error("Erreur lors de la création du répertoire");
   }
+  // Les chemins sous le nouveau répertoire ne doivent pas être servis par le cache
+  dentry_cache_invalidate(path);
   // Ferme le système de fichiers
   close_fs(fd, map, size);
   return 0;
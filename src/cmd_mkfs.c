@@ -4,9 +4,11 @@
 // Fonction de création du système de fichiers (mkfs)
 int cmd_mkfs(const char *fsname, int nbi, int nba)
 {
+  // L'inode du répertoire racine s'ajoute aux nbi inodes demandés
+  int32_t nbi_total = nbi + 1;
   // Calcul initial du nombre de blocs
-  int32_t nb1 = (int32_t)ceil((1 + nbi + nba) / 32000.0);
-  int32_t nbb = 1 + nb1 + nbi + nba;
+  int32_t nb1 = (int32_t)ceil((1 + nbi_total + nba) / 32000.0);
+  int32_t nbb = 1 + nb1 + nbi_total + nba;
   int32_t nb1_new;
   // Boucle pour recalculer jusqu'à convergence
   while (1)
@@ -17,7 +19,7 @@ int cmd_mkfs(const char *fsname, int nbi, int nba)
       break;
     }
     nb1 = nb1_new;
-    nbb = 1 + nb1 + nbi + nba;
+    nbb = 1 + nb1 + nbi_total + nba;
   }
   // Création et dimensionnement du conteneur
   int fd = open(fsname, O_RDWR | O_CREAT | O_TRUNC, 0666);
@@ -43,21 +45,15 @@ int cmd_mkfs(const char *fsname, int nbi, int nba)
     return 1;
   }
 
-  for (int32_t i = 0; i < nbb; i++)
-  {
-    calcul_sha1(map + (int64_t)i * 4096, 4000, ((uint8_t *)map + (int64_t)i * 4096) + 4000);
-  }
-
   // 1) Superbloc
   struct pignoufs *sb = (struct pignoufs *)map;
   memset(sb, 0, sizeof(*sb));
   memcpy(sb->magic, "pignoufs", 8);
   sb->nb_b = TO_LE32(nbb);
-  sb->nb_i = TO_LE32(nbi);
+  sb->nb_i = TO_LE32(nbi_total);
   sb->nb_a = TO_LE32(nba);
   sb->nb_l = TO_LE32(nba);
   sb->nb_f = TO_LE32(0);
-  calcul_sha1(sb, 4000, sb->sha1);
   sb->type = TO_LE32(1);
 
   // 2) Blocs de bitmap
@@ -73,30 +69,52 @@ int cmd_mkfs(const char *fsname, int nbi, int nba)
       if (b >= 1 + nb1 && b < nbb)
         bb->bits[j / 8] |= (1 << (j % 8));
     }
-    calcul_sha1(bb->bits, 4000, bb->sha1);
     bb->type = TO_LE32(2);
   }
 
   // 3) Blocs d'inodes
-  for (int32_t i = 0; i < nbi; i++)
+  for (int32_t i = 0; i < nbi_total; i++)
   {
-    struct inode *in = get_inode(map, 1 + nb1 + i);
+    struct inode *in = (struct inode *)((uint8_t *)map + (int64_t)(1 + nb1 + i) * 4096);
     // Initialise chaque inode à zéro (libre)
     memset(in, 0, sizeof(*in)); // marquer l'inode comme libre
-    calcul_sha1(in, 4000, in->sha1);
     in->type = TO_LE32(3);
   }
 
+  // Inode du répertoire racine : premier bloc d'inodes, marqué alloué dans le bitmap
+  int32_t root = 1 + nb1;
+  struct inode *in = (struct inode *)((uint8_t *)map + (int64_t)root * 4096);
+  init_inode(in, "", true);
+  in->profondeur = TO_LE32(-1);
+  struct bitmap_block *bb = (struct bitmap_block *)((uint8_t *)map + (int64_t)(root / 32000 + 1) * 4096);
+  bb->bits[(root % 32000) / 8] &= ~(1 << (root % 8));
+  sb->root_inode = TO_LE32(root);
+  sb->features = TO_LE32(PFS_FEATURE_ROOT | PFS_FEATURE_PARENT | PFS_FEATURE_SIZE64);
+  sb->nb_f = TO_LE32(1);
+
   // 4) Blocs de données
   for (int32_t i = 0; i < nba; i++)
   {
-    struct data_block *db = get_data_block(map, 1 + nb1 + nbi + i);
+    struct data_block *db = (struct data_block *)((uint8_t *)map + (int64_t)(1 + nb1 + nbi_total + i) * 4096);
     // Initialise chaque bloc de données à zéro
     memset(db->data, 0, sizeof(db->data));
-    calcul_sha1(db->data, 4000, db->sha1);
     db->type = TO_LE32(4);
   }
 
+  // 5) SHA1 de tous les blocs, calculés par lots
+  const void *data[256];
+  uint8_t *out[256];
+  for (int32_t i = 0; i < nbb; i += 256)
+  {
+    int n = (nbb - i < 256) ? nbb - i : 256;
+    for (int k = 0; k < n; k++)
+    {
+      data[k] = (uint8_t *)map + (int64_t)(i + k) * 4096;
+      out[k] = (uint8_t *)map + (int64_t)(i + k) * 4096 + 4000;
+    }
+    calcul_sha1_many(data, n, 4000, out);
+  }
+
   // Synchronise et libère la mémoire mappée
   msync(map, filesize, MS_SYNC);
   int er = munmap(map, filesize);
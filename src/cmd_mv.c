@@ -1,16 +1,19 @@
 #include "../include/structures.h"
 #include "../include/utilitaires.h"
+#include "../include/index_dossier.h"
+#include "../include/cache_chemins.h"
 
 int cmd_mv(const char *fsname, const char *oldpath, const char *newpath)
 {
   uint8_t *map;
   size_t size;
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs(fsname, &map, &size, ACCESS_RANDOM);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
   int32_t nb1, nbi, nba, nbb;
   get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int32_t root = get_root_inode(map);
 
   // Découper les chemins source et destination
   char old_parent_path[256], old_name[256];
@@ -47,6 +50,8 @@ int cmd_mv(const char *fsname, const char *oldpath, const char *newpath)
         return print_error("Erreur: répertoire inexistant");
       }
       old_parent2 = get_inode(map, val1_2); // dossier racine
+      if (root >= 0)
+        old_parent = get_inode(map, root);
     }
     else
     {
@@ -77,6 +82,8 @@ int cmd_mv(const char *fsname, const char *oldpath, const char *newpath)
         return print_error("Erreur: fichier inexistant");
       }
       old_parent2 = get_inode(map, val1_2); // fichier racine
+      if (root >= 0)
+        old_parent = get_inode(map, root);
     }
     else
     {
@@ -169,15 +176,25 @@ int cmd_mv(const char *fsname, const char *oldpath, const char *newpath)
   {
     if (strlen(new_name) > 0)
     {
+      // L'entrée de l'index du dossier parent dépend du nom : retrait avant, ajout après
+      if (old_parent)
+        dir_index_remove(map, old_parent, val1_2);
       strncpy(old_parent2->filename, new_name, 255);
       old_parent2->filename[255] = '\0';
+      if (old_parent)
+        dir_index_insert(map, old_parent, val1_2);
     }
     old_parent2->modification_time = TO_LE32(time(NULL));
-    calcul_sha1(old_parent2, 4000, old_parent2->sha1);
+    update_block_sha1(old_parent2);
   }
   // Cas déplacement dans un autre dossier (même type)
   else if ((!is_dir && !is_dir2) || (is_dir && is_dir2))
   {
+    // Retrait de l'ancien dossier avant le renommage (l'index du dossier dépend du nom)
+    if (old_parent)
+    {
+      delete_separte_inode(map, old_parent, val1_2);
+    }
     if (strcmp(old_name, new_name) != 0)
     {
       strncpy(old_parent2->filename, new_name, 255);
@@ -186,37 +203,35 @@ int cmd_mv(const char *fsname, const char *oldpath, const char *newpath)
     if (strlen(new_parent_path) == 0)
     {
       old_parent2->profondeur = TO_LE32(0);
+      add_root_entry(map, val1_2);
     }
     else
     {
       old_parent2->profondeur = TO_LE32(FROM_LE32(new_parent->profondeur) + 1);
-      add_inode(new_parent, val1_2);
+      add_inode(map, new_parent, val1_2);
     }
     old_parent2->modification_time = TO_LE32(time(NULL));
-    calcul_sha1(old_parent2, 4000, old_parent2->sha1);
-    if (strlen(old_parent_path) != 0)
-    {
-      delete_separte_inode(old_parent, val1_2);
-    }
+    update_block_sha1(old_parent2);
   }
   // Cas déplacement fichier vers dossier
   else if (!is_dir && is_dir2)
   {
+    if (old_parent)
+    {
+      delete_separte_inode(map, old_parent, val1_2);
+    }
     if (strlen(new_name) == 0)
     {
       old_parent2->profondeur = TO_LE32(0);
+      add_root_entry(map, val1_2);
     }
     else
     {
       old_parent2->profondeur = TO_LE32(FROM_LE32(new_parent->profondeur) + 1);
-      add_inode(new_parent, val1_2);
+      add_inode(map, new_parent, val1_2);
     }
     old_parent2->modification_time = TO_LE32(time(NULL));
-    calcul_sha1(old_parent2, 4000, old_parent2->sha1);
-    if (strlen(old_parent_path) != 0)
-    {
-      delete_separte_inode(old_parent, val1_2);
-    }
+    update_block_sha1(old_parent2);
   }
   // Cas interdit : déplacement dossier dans fichier
   else
@@ -225,6 +240,8 @@ int cmd_mv(const char *fsname, const char *oldpath, const char *newpath)
     return print_error("Erreur: déplacement impossible dossier dans fichier");
   }
 
+  // L'ancien chemin et tout ce qui était en dessous a changé de place
+  dentry_cache_invalidate(oldpath);
   close_fs(fd, map, size);
 
   return 0;
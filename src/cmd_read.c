@@ -0,0 +1,87 @@
+#include "../include/structures.h"
+#include "../include/utilitaires.h"
+#include "../include/lecture_ecriture.h"
+
+// Taille des morceaux lus puis envoyés sur la sortie standard
+#define READ_CHUNK (64 * 4000)
+
+// Affiche length octets d'un fichier interne à partir de offset (jusqu'à la fin du fichier au plus)
+int cmd_read(const char *fsname, const char *filename, uint64_t offset, uint64_t length)
+{
+  uint8_t *map;
+  size_t size;
+  int fd = open_fs_ro(fsname, &map, &size, ACCESS_SEQUENTIAL);
+  if (fd < 0)
+    return print_error("Erreur lors de l'ouverture du système de fichiers");
+
+  int32_t nb1, nbi, nba, nbb;
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+
+  char parent_path[256], dir_name[256];
+  split_path(filename, parent_path, dir_name);
+
+  int val = -1;
+  if (strlen(parent_path) == 0)
+    val = find_inode_racine(map, nb1, nbi, dir_name, false);
+  else
+  {
+    val = find_inode_folder(map, nb1, nbi, parent_path);
+    if (val < 0)
+    {
+      print_error("Répertoire introuvable");
+      close_fs(fd, map, size);
+      return 1;
+    }
+    val = find_file_folder_from_inode(map, get_inode(map, val), dir_name, false);
+  }
+  if (val < 0)
+  {
+    print_error("Fichier introuvable");
+    close_fs(fd, map, size);
+    return 1;
+  }
+  struct inode *in = get_inode(map, val);
+
+  // Vérifie les droits de lecture et que le fichier n'est pas verrouillé
+  if (!((FROM_LE32(in->flags) >> 1) & 1) || ((FROM_LE32(in->flags) >> 3) & 1))
+  {
+    print_error("Erreur: pas de droit de lecture/fichier locké");
+    close_fs(fd, map, size);
+    return 1;
+  }
+  int64_t inode_offset = block_offset_of(map, in);
+  if (lock_block(fd, inode_offset, F_RDLCK) < 0)
+  {
+    print_error("Erreur lors du verrouillage de l'inode");
+    close_fs(fd, map, size);
+    return 1;
+  }
+
+  char *buf = malloc(READ_CHUNK);
+  if (!buf)
+  {
+    print_error("Erreur d'allocation mémoire");
+    unlock_block(fd, inode_offset);
+    close_fs(fd, map, size);
+    return 1;
+  }
+  int ret = 0;
+  while (length > 0 && ret == 0)
+  {
+    ssize_t r = pfs_pread(map, in, buf, length < READ_CHUNK ? length : READ_CHUNK, offset);
+    if (r <= 0)
+      break;
+    if (write(STDOUT_FILENO, buf, r) != r)
+    {
+      print_error("write: erreur d'écriture");
+      ret = 1;
+    }
+    offset += r;
+    length -= r;
+  }
+  free(buf);
+
+  unlock_block(fd, inode_offset);
+  close_fs(fd, map, size);
+  return ret;
+}
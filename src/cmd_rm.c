@@ -1,11 +1,12 @@
 #include "../include/structures.h"
 #include "../include/utilitaires.h"
+#include "../include/cache_chemins.h"
 
 int cmd_rm(const char *fsname, const char *filename)
 {
   uint8_t *map;
   size_t size;
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs(fsname, &map, &size, ACCESS_RANDOM);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -54,7 +55,7 @@ int cmd_rm(const char *fsname, const char *filename)
       return print_error("Erreur: répertoire à supprimer inexistant");
     }
     in2 = get_inode(map, val2);
-    delete_separte_inode(in, val2);
+    delete_separte_inode(map, in, val2);
   }
 
   // Vérifie les permissions et les locks :
@@ -66,7 +67,10 @@ int cmd_rm(const char *fsname, const char *filename)
   }
 
   // Supprime l'inode et libère les blocs associés
+  if (strlen(parent_path) == 0)
+    delete_root_entry(map, val2);
   delete_inode(in2, map, val2, fd, size);
+  dentry_cache_invalidate(filename);
 
   close_fs(fd, map, size);
   return 0;
@@ -22,12 +22,11 @@ void print_tree(uint8_t *map, int32_t nb1, int32_t nbi, struct inode *inode, int
     return;
 
   // Si c'est une racine, afficher l'arborescence complète
-  for (int i = 0; i < 900; i++)
+  struct dir_iter it;
+  dir_iter_init(&it, map, inode);
+  int32_t block_idx;
+  while ((block_idx = dir_iter_next(&it)) >= 0)
   {
-    int32_t block_idx = FROM_LE32(inode->direct_blocks[i]);
-    if (block_idx == -1)
-      continue;
-
     struct inode *child_inode = get_inode(map, block_idx);
     print_tree(map, nb1, nbi, child_inode, depth + 1, visited_inodes);
   }
@@ -38,7 +37,7 @@ int cmd_tree(const char *fsname)
 {
   uint8_t *map;
   size_t size;
-  int fd = open_fs(fsname, &map, &size);
+  int fd = open_fs_ro(fsname, &map, &size, ACCESS_RANDOM);
   if (fd < 0)
     return print_error("Erreur lors de l'ouverture du système de fichiers");
 
@@ -53,11 +52,29 @@ int cmd_tree(const char *fsname)
   }
 
   int racine_trouvee = 0;
-  for (int i = 0; i < nbi; i++)
+  int32_t root = get_root_inode(map);
+  // Dossiers de premier niveau : enfants de l'inode racine, ou entrées de profondeur 0 d'un ancien conteneur
+  struct dir_iter it;
+  if (root >= 0)
+    dir_iter_init(&it, map, get_inode(map, root));
+  for (int i = 0; root >= 0 || i < nbi; i++)
   {
-    struct inode *in = get_inode(map, 1 + nb1 + i);
+    struct inode *in;
+    if (root >= 0)
+    {
+      int32_t child = dir_iter_next(&it);
+      if (child < 0)
+        break;
+      in = get_inode(map, child);
+    }
+    else
+    {
+      in = get_inode(map, 1 + nb1 + i);
+      if (FROM_LE32(in->profondeur) != 0)
+        continue;
+    }
 
-    if ((FROM_LE32(in->flags) & 1) && ((FROM_LE32(in->flags) >> 5) & 1) && FROM_LE32(in->profondeur) == 0)
+    if ((FROM_LE32(in->flags) & 1) && ((FROM_LE32(in->flags) >> 5) & 1))
     {
       print_tree(map, nb1, nbi, in, 0, visited_inodes);
       racine_trouvee = 1;
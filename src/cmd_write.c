@@ -0,0 +1,83 @@
+#include "../include/structures.h"
+#include "../include/utilitaires.h"
+#include "../include/lecture_ecriture.h"
+
+// Taille des morceaux lus sur l'entrée standard
+#define WRITE_CHUNK (64 * 4000)
+
+// Écrit l'entrée standard dans un fichier interne existant à partir de offset, sans le tronquer
+int cmd_write(const char *fsname, const char *filename, uint64_t offset)
+{
+  uint8_t *map;
+  size_t size;
+  int fd = open_fs(fsname, &map, &size, ACCESS_SEQUENTIAL);
+  if (fd < 0)
+    return print_error("Erreur lors de l'ouverture du système de fichiers");
+
+  int32_t nb1, nbi, nba, nbb;
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+
+  char parent_path[256], dir_name[256];
+  split_path(filename, parent_path, dir_name);
+
+  int val = -1;
+  if (strlen(parent_path) == 0)
+    val = find_inode_racine(map, nb1, nbi, dir_name, false);
+  else
+  {
+    val = find_inode_folder(map, nb1, nbi, parent_path);
+    if (val < 0)
+    {
+      print_error("Répertoire introuvable");
+      close_fs(fd, map, size);
+      return 1;
+    }
+    val = find_file_folder_from_inode(map, get_inode(map, val), dir_name, false);
+  }
+  if (val < 0)
+  {
+    print_error("Fichier introuvable");
+    close_fs(fd, map, size);
+    return 1;
+  }
+  struct inode *in = get_inode(map, val);
+
+  // On ne modifie que si l'inode a le droit d'écriture et n'est pas locké en lecture ou écriture
+  if (!((FROM_LE32(in->flags) >> 2) & 1) || ((FROM_LE32(in->flags) >> 3) & 1) || ((FROM_LE32(in->flags) >> 4) & 1))
+  {
+    print_error("Erreur: pas de droit d'écriture ou fichier verrouillé (lecture/écriture)");
+    close_fs(fd, map, size);
+    return 1;
+  }
+  int64_t inode_offset = block_offset_of(map, in);
+  if (lock_block(fd, inode_offset, F_WRLCK) < 0)
+  {
+    print_error("Erreur lors du verrouillage de l'inode");
+    close_fs(fd, map, size);
+    return 1;
+  }
+
+  char *buf = malloc(WRITE_CHUNK);
+  if (!buf)
+  {
+    print_error("Erreur d'allocation mémoire");
+    unlock_block(fd, inode_offset);
+    close_fs(fd, map, size);
+    return 1;
+  }
+  int ret = 0;
+  ssize_t r;
+  while (ret == 0 && (r = read(STDIN_FILENO, buf, WRITE_CHUNK)) > 0)
+  {
+    ssize_t w = pfs_pwrite(map, in, buf, r, offset);
+    if (w != r)
+      ret = 1;
+    if (w > 0)
+      offset += w;
+  }
+  free(buf);
+
+  unlock_block(fd, inode_offset);
+  close_fs(fd, map, size);
+  return ret;
+}
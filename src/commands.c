@@ -4,8 +4,87 @@
 void print_usage()
 {
   fprintf(stderr, "Usage: <nom_de_commande> <fsname> [options]\n");
-  fprintf(stderr, "Commandes disponibles : mkfs, ls, df, cp, rm, lock, chmod, cat, input, add, addinput, fsck, mount.\n");
+  fprintf(stderr, "Commandes disponibles : mkfs, ls, df, cp, rm, lock, chmod, cat, read, write, punch, input, add, addinput, fsck, mount.\n");
   fprintf(stderr, "Options disponibles : -v (verbose), -h (help), etc.\n");
+  fprintf(stderr, "Options globales : --verify=always|once|fsck (vérification des SHA1 à la lecture),\n");
+  fprintf(stderr, "                   --sync=sync|async|none (écriture des blocs modifiés à la fermeture),\n");
+  fprintf(stderr, "                   --resident=<Mo> (mémoire chargée au plus, par fenêtres de 64 Mo),\n");
+  fprintf(stderr, "                   --access=default|random|sequential|scan (conseils au noyau, à la place de ceux de la commande).\n");
+}
+
+// Applique et retire de argv les options globales de la forme --option=valeur
+// Retourne le nouveau argc, ou -1 si une option est invalide
+static int parse_global_options(int argc, char *argv[])
+{
+  int n = 1;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strncmp(argv[i], "--verify=", 9) == 0)
+    {
+      const char *policy = argv[i] + 9;
+      if (strcmp(policy, "always") == 0)
+        set_verify_policy(VERIFY_ALWAYS);
+      else if (strcmp(policy, "once") == 0)
+        set_verify_policy(VERIFY_ONCE);
+      else if (strcmp(policy, "fsck") == 0)
+        set_verify_policy(VERIFY_FSCK_ONLY);
+      else
+      {
+        fprintf(stderr, "Erreur: politique de vérification inconnue '%s' (always, once ou fsck).\n", policy);
+        return -1;
+      }
+      continue;
+    }
+    if (strncmp(argv[i], "--sync=", 7) == 0)
+    {
+      const char *mode = argv[i] + 7;
+      if (strcmp(mode, "sync") == 0)
+        set_sync_mode(SYNC_FULL);
+      else if (strcmp(mode, "async") == 0)
+        set_sync_mode(SYNC_ASYNC);
+      else if (strcmp(mode, "none") == 0)
+        set_sync_mode(SYNC_NONE);
+      else
+      {
+        fprintf(stderr, "Erreur: mode d'écriture inconnu '%s' (sync, async ou none).\n", mode);
+        return -1;
+      }
+      continue;
+    }
+    if (strncmp(argv[i], "--access=", 9) == 0)
+    {
+      const char *profile = argv[i] + 9;
+      if (strcmp(profile, "default") == 0)
+        set_access_override(ACCESS_DEFAULT);
+      else if (strcmp(profile, "random") == 0)
+        set_access_override(ACCESS_RANDOM);
+      else if (strcmp(profile, "sequential") == 0)
+        set_access_override(ACCESS_SEQUENTIAL);
+      else if (strcmp(profile, "scan") == 0)
+        set_access_override(ACCESS_SCAN);
+      else
+      {
+        fprintf(stderr, "Erreur: profil d'accès inconnu '%s' (default, random, sequential ou scan).\n", profile);
+        return -1;
+      }
+      continue;
+    }
+    if (strncmp(argv[i], "--resident=", 11) == 0)
+    {
+      char *end;
+      long mb = strtol(argv[i] + 11, &end, 10);
+      if (end == argv[i] + 11 || *end != '\0' || mb < 0 || mb > INT32_MAX)
+      {
+        fprintf(stderr, "Erreur: taille résidente invalide '%s' (en Mo, 0 pour aucune limite).\n", argv[i] + 11);
+        return -1;
+      }
+      set_resident_limit((int32_t)mb);
+      continue;
+    }
+    argv[n++] = argv[i];
+  }
+  argv[n] = NULL;
+  return n;
 }
 
 int commands(int argc, char *argv[])
@@ -13,6 +92,15 @@ int commands(int argc, char *argv[])
   char *command = strrchr(argv[0], '/');
   command = (command) ? command + 1 : argv[0]; // Si '/' trouvé, avancer d’un caractère
 
+  argc = parse_global_options(argc, argv);
+  if (argc < 0)
+    return 1;
+  if (argc < 2)
+  {
+    print_usage();
+    return 1;
+  }
+
   // Vérifier les options globales
   for (int i = 1; i < argc; i++)
   {
@@ -400,6 +488,53 @@ int commands(int argc, char *argv[])
     newpath += 2; // Ignorer les deux premiers caractères
     return cmd_mv(fsname, oldpath, newpath);
   }
+  else if (strcmp(command, "read") == 0 || strcmp(command, "write") == 0 || strcmp(command, "punch") == 0)
+  {
+    bool is_write = strcmp(command, "write") == 0;
+    if (argc < 3)
+    {
+      fprintf(stderr, "Usage: %s <fsname> //fichier [--offset N]%s\n", command, is_write ? "" : " [--length N]");
+      return 1;
+    }
+    const char *filename = argv[2];
+    if (strncmp(filename, "//", 2) != 0)
+    {
+      fprintf(stderr, "Erreur: Le nom de fichier interne doit commencer par \"//\".\n");
+      return 1;
+    }
+    filename += 2;
+    if (strlen(filename) == 0 || filename[strlen(filename) - 1] == '/')
+    {
+      fprintf(stderr, "Erreur: Le nom de fichier ne doit pas se terminer par '/'.\n");
+      return 1;
+    }
+    uint64_t offset = 0, length = UINT64_MAX;
+    for (int i = 3; i < argc; i++)
+    {
+      uint64_t *target = NULL;
+      if (strcmp(argv[i], "--offset") == 0)
+        target = &offset;
+      else if (strcmp(argv[i], "--length") == 0 && !is_write)
+        target = &length;
+      if (target == NULL || i + 1 >= argc)
+      {
+        fprintf(stderr, "Erreur: option inconnue ou incomplète '%s'.\n", argv[i]);
+        return 1;
+      }
+      char *endptr;
+      *target = strtoull(argv[++i], &endptr, 10);
+      if (*endptr != '\0' || argv[i][0] == '-')
+      {
+        fprintf(stderr, "Erreur: %s n'est pas un nombre valide.\n", argv[i]);
+        return 1;
+      }
+    }
+    if (is_write)
+      return cmd_write(fsname, filename, offset);
+    if (strcmp(command, "punch") == 0)
+      return cmd_punch(fsname, filename, offset, length);
+    return cmd_read(fsname, filename, offset, length);
+  }
   else
   {
     fprintf(stderr, "Erreur : commande inconnue '%s'\n", command);
@@ -0,0 +1,229 @@
+#include "../include/index_dossier.h"
+#include "../include/utilitaires.h"
+
+#define SLOTS_PER_BLOCK 1000
+#define SLOT_EMPTY -1
+#define SLOT_FREED -2
+
+// FNV-1a 32 bits
+static uint32_t hash_name(const char *name)
+{
+  uint32_t h = 2166136261u;
+  for (const unsigned char *p = (const unsigned char *)name; *p; p++)
+  {
+    h ^= *p;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static struct dir_index_block *get_index_header(uint8_t *map, int32_t b)
+{
+  return (struct dir_index_block *)get_data_block(map, b);
+}
+
+// Numéro du q-ième bloc de cases : listé dans l'en-tête, ou dans une page d'adresses pour un grand index
+static int32_t dir_index_slot_block(uint8_t *map, const struct dir_index_block *h, int32_t q)
+{
+  if (FROM_LE32(h->nb_slot_blocks) <= DIR_INDEX_DIRECT)
+    return FROM_LE32(h->slot_blocks[q]);
+  struct address_block *page = get_address_block(map, FROM_LE32(h->slot_blocks[q / 1000]));
+  return FROM_LE32(page->addresses[q % 1000]);
+}
+
+// Nombre de pages d'adresses d'un index de k blocs de cases (0 : blocs listés dans l'en-tête)
+static int32_t dir_index_pages(int32_t k)
+{
+  return k <= DIR_INDEX_DIRECT ? 0 : (k + 999) / 1000;
+}
+
+// Bloc de cases contenant la case i
+static struct address_block *get_slot_block(uint8_t *map, struct dir_index_block *h, uint32_t i)
+{
+  return get_address_block(map, dir_index_slot_block(map, h, i / SLOTS_PER_BLOCK));
+}
+
+// Place un enfant dans la première case vide ou libérée de sa séquence de sondage
+static bool dir_index_place(uint8_t *map, struct dir_index_block *h, int32_t child, const char *name)
+{
+  uint32_t cap = FROM_LE32(h->nb_slot_blocks) * SLOTS_PER_BLOCK;
+  uint32_t i = hash_name(name) % cap;
+  for (uint32_t n = 0; n < cap; n++, i = (i + 1) % cap)
+  {
+    struct address_block *blk = get_slot_block(map, h, i);
+    int32_t v = FROM_LE32(blk->addresses[i % SLOTS_PER_BLOCK]);
+    if (v != SLOT_EMPTY && v != SLOT_FREED)
+      continue;
+    if (v == SLOT_FREED)
+      h->tombstones = TO_LE32(FROM_LE32(h->tombstones) - 1);
+    blk->addresses[i % SLOTS_PER_BLOCK] = TO_LE32(child);
+    update_block_sha1(blk);
+    h->count = TO_LE32(FROM_LE32(h->count) + 1);
+    update_block_sha1(h);
+    return true;
+  }
+  return false;
+}
+
+void dir_index_free(uint8_t *map, struct inode *dir)
+{
+  int32_t hb = FROM_LE32(dir->dir_index);
+  if (hb <= 0)
+    return;
+  struct dir_index_block *h = get_index_header(map, hb);
+  int32_t k = FROM_LE32(h->nb_slot_blocks);
+  for (int32_t q = 0; q < k; q++)
+    release_block(map, dir_index_slot_block(map, h, q));
+  for (int32_t p = 0; p < dir_index_pages(k); p++)
+    release_block(map, FROM_LE32(h->slot_blocks[p]));
+  release_block(map, hb);
+  dir->dir_index = TO_LE32(0);
+  update_block_sha1(dir);
+}
+
+// (Re)construit l'index à partir des enfants du répertoire, dimensionné pour n entrées (taux de remplissage 1/4).
+// Sans place pour l'index ou pour l'un des enfants, le répertoire reste sans index (parcours linéaire)
+static void dir_index_build(uint8_t *map, struct inode *dir, int32_t n)
+{
+  dir_index_free(map, dir);
+  int32_t k = (int32_t)(((int64_t)n * 4 + SLOTS_PER_BLOCK - 1) / SLOTS_PER_BLOCK);
+  if (k < 1)
+    k = 1;
+  if (k > DIR_INDEX_MAX_BLOCKS)
+    k = DIR_INDEX_MAX_BLOCKS;
+  int32_t pages = dir_index_pages(k);
+
+  int32_t blocks[1 + (DIR_INDEX_MAX_BLOCKS + 999) / 1000 + DIR_INDEX_MAX_BLOCKS];
+  int32_t got = alloc_data_blocks(map, 1 + pages + k, blocks);
+  if (got != 1 + pages + k)
+  {
+    for (int32_t i = 0; i < got; i++)
+      release_block(map, blocks[i]);
+    return;
+  }
+
+  struct dir_index_block *h = (struct dir_index_block *)get_data_block(map, blocks[0]);
+  memset(h, 0, 4000);
+  h->nb_slot_blocks = TO_LE32(k);
+  for (int32_t p = 0; p < pages; p++)
+  {
+    h->slot_blocks[p] = TO_LE32(blocks[1 + p]);
+    struct address_block *page = get_address_block(map, blocks[1 + p]);
+    memset(page->addresses, 0xff, sizeof(page->addresses));
+    page->type = TO_LE32(6);
+  }
+  for (int32_t q = 0; q < k; q++)
+  {
+    int32_t b = blocks[1 + pages + q];
+    if (pages > 0)
+      get_address_block(map, blocks[1 + q / 1000])->addresses[q % 1000] = TO_LE32(b);
+    else
+      h->slot_blocks[q] = TO_LE32(b);
+    struct address_block *blk = get_address_block(map, b);
+    memset(blk->addresses, 0xff, sizeof(blk->addresses)); // SLOT_EMPTY partout
+    blk->type = TO_LE32(9);
+    update_block_sha1(blk);
+  }
+  for (int32_t p = 0; p < pages; p++)
+    update_block_sha1(get_address_block(map, blocks[1 + p]));
+  h->type = TO_LE32(8);
+  update_block_sha1(h);
+  dir->dir_index = TO_LE32(blocks[0]);
+  update_block_sha1(dir);
+
+  struct dir_iter it;
+  dir_iter_init(&it, map, dir);
+  int32_t c;
+  while ((c = dir_iter_next(&it)) >= 0)
+    if (!dir_index_place(map, h, c, get_inode(map, c)->filename))
+    {
+      // Un enfant absent de l'index serait introuvable : on revient au parcours linéaire
+      dir_index_free(map, dir);
+      return;
+    }
+}
+
+int32_t dir_index_lookup(uint8_t *map, struct inode *dir, const char *name, bool type)
+{
+  int32_t hb = FROM_LE32(dir->dir_index);
+  if (hb <= 0)
+    return -2;
+  struct dir_index_block *h = get_index_header(map, hb);
+  uint32_t cap = FROM_LE32(h->nb_slot_blocks) * SLOTS_PER_BLOCK;
+  uint32_t i = hash_name(name) % cap;
+  for (uint32_t n = 0; n < cap; n++, i = (i + 1) % cap)
+  {
+    int32_t v = FROM_LE32(get_slot_block(map, h, i)->addresses[i % SLOTS_PER_BLOCK]);
+    if (v == SLOT_EMPTY)
+      break;
+    if (v < 0)
+      continue;
+    struct inode *c = get_inode(map, v);
+    uint32_t flags = FROM_LE32(c->flags);
+    if ((flags & 1) && ((flags >> 5) & 1) == type && strcmp(c->filename, name) == 0)
+      return v;
+  }
+  return -1;
+}
+
+void dir_index_insert(uint8_t *map, struct inode *dir, int32_t child)
+{
+  int32_t hb = FROM_LE32(dir->dir_index);
+  if (hb <= 0)
+  {
+    // Pas d'index (jamais créé ou abandonné faute de place) : on le crée pour tous les enfants
+    // dès que le répertoire est assez grand
+    int32_t n = 0;
+    struct dir_iter it;
+    dir_iter_init(&it, map, dir);
+    while (dir_iter_next(&it) >= 0)
+      n++;
+    if (n >= DIR_INDEX_MIN)
+      dir_index_build(map, dir, n);
+    return;
+  }
+  struct dir_index_block *h = get_index_header(map, hb);
+  int32_t k = FROM_LE32(h->nb_slot_blocks);
+  int64_t used = FROM_LE32(h->count) + FROM_LE32(h->tombstones) + 1;
+  // Au-delà de la moitié des cases occupées, on reconstruit (agrandit et purge les cases libérées),
+  // sauf si la reconstruction ne changerait rien (taille maximale sans case libérée)
+  if (used * 2 > (int64_t)k * SLOTS_PER_BLOCK && (k < DIR_INDEX_MAX_BLOCKS || FROM_LE32(h->tombstones) > 0))
+  {
+    dir_index_build(map, dir, FROM_LE32(h->count) + 1);
+    return;
+  }
+  if (!dir_index_place(map, h, child, get_inode(map, child)->filename))
+    dir_index_free(map, dir);
+}
+
+void dir_index_remove(uint8_t *map, struct inode *dir, int32_t child)
+{
+  int32_t hb = FROM_LE32(dir->dir_index);
+  if (hb <= 0)
+    return;
+  struct dir_index_block *h = get_index_header(map, hb);
+  uint32_t cap = FROM_LE32(h->nb_slot_blocks) * SLOTS_PER_BLOCK;
+  uint32_t i = hash_name(get_inode(map, child)->filename) % cap;
+  uint32_t n = 0;
+  for (; n < cap; n++, i = (i + 1) % cap)
+  {
+    int32_t v = FROM_LE32(get_slot_block(map, h, i)->addresses[i % SLOTS_PER_BLOCK]);
+    if (v == child || v == SLOT_EMPTY)
+      break;
+  }
+  // Nom modifié sans mise à jour de l'index : on cherche l'entrée dans toutes les cases
+  if (n == cap || (int32_t)FROM_LE32(get_slot_block(map, h, i)->addresses[i % SLOTS_PER_BLOCK]) != child)
+  {
+    for (i = 0; i < cap; i++)
+      if ((int32_t)FROM_LE32(get_slot_block(map, h, i)->addresses[i % SLOTS_PER_BLOCK]) == child)
+        break;
+    if (i == cap)
+      return;
+  }
+  struct address_block *blk = get_slot_block(map, h, i);
+  blk->addresses[i % SLOTS_PER_BLOCK] = TO_LE32(SLOT_FREED);
+  update_block_sha1(blk);
+  h->count = TO_LE32(FROM_LE32(h->count) - 1);
+  h->tombstones = TO_LE32(FROM_LE32(h->tombstones) + 1);
+  update_block_sha1(h);
+}
@@ -0,0 +1,131 @@
+#include "../include/lecture_ecriture.h"
+#include "../include/utilitaires.h"
+
+ssize_t pfs_pread(uint8_t *map, struct inode *in, void *buf, size_t len, uint64_t offset)
+{
+  uint64_t file_size = inode_size(in);
+  if (offset >= file_size)
+    return 0;
+  if (len > file_size - offset)
+    len = file_size - offset;
+  size_t done = 0;
+  while (done < len)
+  {
+    uint64_t pos = offset + done;
+    uint32_t within = pos % 4000;
+    size_t n = len - done < 4000 - within ? len - done : 4000 - within;
+    // Rang du bloc obtenu par calcul, sans parcourir les blocs précédents
+    int32_t b = file_block_at(map, in, pos / 4000, false);
+    if (b < 0)
+      memset((uint8_t *)buf + done, 0, n); // Trou : lu comme des zéros
+    else
+      memcpy((uint8_t *)buf + done, get_data_block(map, b)->data + within, n);
+    done += n;
+  }
+  return done;
+}
+
+// Écrit src sur [offset, offset + len) en allouant les blocs manquants ; renvoie le nombre d'octets écrits
+static size_t pfs_write_range(uint8_t *map, struct inode *in, const uint8_t *src, size_t len, uint64_t offset)
+{
+  size_t done = 0;
+  while (done < len)
+  {
+    uint64_t pos = offset + done;
+    uint32_t within = pos % 4000;
+    size_t n = len - done < 4000 - within ? len - done : 4000 - within;
+    int32_t b = file_block_at(map, in, pos / 4000, true);
+    if (b < 0)
+      break;
+    struct data_block *db = get_data_block(map, b);
+    memcpy(db->data + within, src + done, n);
+    update_block_sha1(db);
+    done += n;
+  }
+  return done;
+}
+
+// Remet à zéro [offset, offset + len) dans les blocs existants ; les trous restent des trous
+static void pfs_zero_range(uint8_t *map, struct inode *in, uint64_t offset, uint64_t len)
+{
+  uint64_t done = 0;
+  while (done < len)
+  {
+    uint64_t pos = offset + done;
+    uint32_t within = pos % 4000;
+    uint64_t n = len - done < 4000 - within ? len - done : 4000 - within;
+    int32_t b = file_block_at(map, in, pos / 4000, false);
+    if (b >= 0)
+    {
+      struct data_block *db = get_data_block(map, b);
+      memset(db->data + within, 0, n);
+      update_block_sha1(db);
+    }
+    done += n;
+  }
+}
+
+ssize_t pfs_pwrite(uint8_t *map, struct inode *in, const void *buf, size_t len, uint64_t offset)
+{
+  uint64_t file_size = inode_size(in);
+  if (offset > PFS_MAX_FILE_SIZE || len > PFS_MAX_FILE_SIZE - offset)
+  {
+    print_error("Erreur: écriture au-delà de la taille maximale d'un fichier");
+    return -1;
+  }
+  if (len == 0)
+    return 0;
+  if (offset <= file_size)
+  {
+    // Les blocs ajoutés en fin de fichier sont réservés d'un coup (contigus si possible)
+    if (offset + len > file_size)
+      reserve_for_append(map, in, offset + len - file_size);
+  }
+  else
+  {
+    // Écriture après la fin : l'écart reste un trou, seuls les blocs écrits sont réservés
+    reserve_data_blocks(map, (int32_t)((len + 3999) / 4000 + 1));
+    // La fin du dernier bloc entamé peut contenir d'anciennes données : elle doit se lire comme des zéros
+    uint64_t tail_end = file_size - file_size % 4000 + 4000;
+    if (file_size % 4000 != 0)
+      pfs_zero_range(map, in, file_size, (tail_end < offset ? tail_end : offset) - file_size);
+  }
+
+  size_t done = pfs_write_range(map, in, buf, len, offset);
+  if (done > 0 && offset + done > file_size)
+    set_inode_size(in, offset + done);
+  in->modification_time = TO_LE32(time(NULL));
+  update_block_sha1(in);
+  if (done < len)
+    print_error("Erreur: pas de blocs de données libres disponibles");
+  return done == 0 ? -1 : (ssize_t)done;
+}
+
+int pfs_punch(uint8_t *map, struct inode *in, uint64_t offset, uint64_t len)
+{
+  uint64_t file_size = inode_size(in);
+  if (offset >= file_size || len == 0)
+    return 0;
+  if (len > file_size - offset)
+    len = file_size - offset;
+  uint64_t end = offset + len;
+  // Blocs entièrement couverts [first, last) : libérés. Le dernier bloc du fichier l'est aussi
+  // si la plage va jusqu'à la fin, le reste de ce bloc n'étant pas lu.
+  uint64_t first = (offset + 3999) / 4000;
+  uint64_t last = end == file_size ? (end + 3999) / 4000 : end / 4000;
+  if (first >= last)
+    pfs_zero_range(map, in, offset, len);
+  else
+  {
+    // Morceaux de blocs aux deux bords : remis à zéro
+    pfs_zero_range(map, in, offset, first * 4000 - offset);
+    if (last * 4000 < end)
+      pfs_zero_range(map, in, last * 4000, end - last * 4000);
+    for (uint64_t i = first; i < last; i++)
+      file_block_punch(map, in, i);
+    file_release_empty_pages(map, in);
+  }
+  in->modification_time = TO_LE32(time(NULL));
+  update_block_sha1(in);
+  return 0;
+}
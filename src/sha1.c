@@ -1,25 +1,6 @@
 #include "../include/sha1.h"
 
-void *sha1_worker(void *arg) {
-  sha1_queue_t *queue = (sha1_queue_t *)arg;
-  while (1) {
-    pthread_mutex_lock(&queue->mutex);
-    while (queue->head == queue->tail && !queue->done)
-        pthread_cond_wait(&queue->cond, &queue->mutex);
-    if (queue->head == queue->tail && queue->done) {
-        pthread_mutex_unlock(&queue->mutex);
-        break;
-    }
-    sha1_task_t task = queue->tasks[queue->head];
-    queue->head = (queue->head + 1) % SHA1_QUEUE_SIZE;
-    pthread_mutex_unlock(&queue->mutex);
-
-    check_sha1(task.data, task.len, task.sha1_ref);
-  }
-  return NULL;
-}
-
-void check_sha1(const void *data, size_t len, uint8_t *out)
+bool check_sha1(const void *data, size_t len, const uint8_t *out)
 {
   uint8_t sha1[20];
   calcul_sha1(data, len, sha1);
@@ -34,35 +15,109 @@ void check_sha1(const void *data, size_t len, uint8_t *out)
       printf("%02x", sha1[i]);
     printf("\n");
     // exit(EXIT_FAILURE);
+    return false;
   }
+  return true;
 }
 
-// Calcul SHA1 d'un bloc de données
-void calcul_sha1(const void *data, size_t len, uint8_t *out)
+// Contexte EVP réutilisé par chaque thread (libéré à la fin du thread)
+static pthread_key_t sha1_ctx_key;
+static pthread_once_t sha1_once = PTHREAD_ONCE_INIT;
+static EVP_MD *sha1_md = NULL;
+
+static void free_sha1_ctx(void *ctx)
+{
+  EVP_MD_CTX_free(ctx);
+}
+
+static void init_sha1_engine(void)
+{
+  pthread_key_create(&sha1_ctx_key, free_sha1_ctx);
+  // Récupération explicite de l'algorithme une seule fois (évite la recherche implicite à chaque init)
+  sha1_md = EVP_MD_fetch(NULL, "SHA1", NULL);
+}
+
+static EVP_MD_CTX *get_sha1_ctx(void)
 {
-  EVP_MD_CTX *ctx = EVP_MD_CTX_new(); // Crée un contexte pour le calcul
+  pthread_once(&sha1_once, init_sha1_engine);
+  EVP_MD_CTX *ctx = pthread_getspecific(sha1_ctx_key);
   if (!ctx)
   {
-    perror("Erreur : Impossible de créer le contexte EVP");
-    return;
+    ctx = EVP_MD_CTX_new(); // Crée un contexte pour le calcul
+    if (!ctx)
+    {
+      perror("Erreur : Impossible de créer le contexte EVP");
+      return NULL;
+    }
+    pthread_setspecific(sha1_ctx_key, ctx);
   }
-  if (EVP_DigestInit_ex(ctx, EVP_sha1(), NULL) != 1)
+  return ctx;
+}
+
+// Noyau choisi au premier appel (le meilleur supporté par le CPU)
+// Un bloc isolé passe par SHA-NI si disponible, les noyaux multi-buffer demandent plusieurs blocs
+static enum sha1_kernel sha1_kernel;
+static bool sha1_single_shani;
+static pthread_once_t sha1_kernel_once = PTHREAD_ONCE_INIT;
+
+static void init_sha1_kernel(void)
+{
+  sha1_kernel = sha1_best_kernel();
+  sha1_single_shani = sha1_kernel_supported(SHA1_KERNEL_SHANI);
+}
+
+bool set_sha1_kernel(enum sha1_kernel kernel)
+{
+  pthread_once(&sha1_kernel_once, init_sha1_kernel);
+  if (!sha1_kernel_supported(kernel))
+    return false;
+  sha1_kernel = kernel;
+  sha1_single_shani = kernel != SHA1_KERNEL_OPENSSL && sha1_kernel_supported(SHA1_KERNEL_SHANI);
+  return true;
+}
+
+static void calcul_sha1_openssl(const void *data, size_t len, uint8_t *out)
+{
+  EVP_MD_CTX *ctx = get_sha1_ctx();
+  if (!ctx)
+    return;
+  if (EVP_DigestInit_ex(ctx, sha1_md ? sha1_md : EVP_sha1(), NULL) != 1)
   {
     perror("Erreur : EVP_DigestInit_ex a échoué");
-    EVP_MD_CTX_free(ctx);
     return;
   }
   if (EVP_DigestUpdate(ctx, data, len) != 1)
   {
     perror("Erreur : EVP_DigestUpdate a échoué");
-    EVP_MD_CTX_free(ctx);
     return;
   }
   if (EVP_DigestFinal_ex(ctx, out, NULL) != 1)
   {
     perror("Erreur : EVP_DigestFinal_ex a échoué");
-    EVP_MD_CTX_free(ctx);
     return;
   }
-  EVP_MD_CTX_free(ctx);
-}
\ No newline at end of file
+}
+
+// Calcul SHA1 d'un bloc de données
+void calcul_sha1(const void *data, size_t len, uint8_t *out)
+{
+  pthread_once(&sha1_kernel_once, init_sha1_kernel);
+  if (sha1_single_shani && sha1_kernel_many(SHA1_KERNEL_SHANI, &data, 1, len, &out))
+    return;
+  calcul_sha1_openssl(data, len, out);
+}
+
+// Calcul SHA1 de n blocs de même taille : out[i] reçoit le SHA1 de data[i]
+void calcul_sha1_many(const void *const data[], int n, size_t len, uint8_t *const out[])
+{
+  pthread_once(&sha1_kernel_once, init_sha1_kernel);
+  if (n == 1)
+  {
+    calcul_sha1(data[0], len, out[0]);
+    return;
+  }
+  if (sha1_kernel_many(sha1_kernel, data, n, len, out))
+    return;
+  for (int i = 0; i < n; i++)
+    calcul_sha1_openssl(data[i], len, out[i]);
+}
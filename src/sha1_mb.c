@@ -0,0 +1,340 @@
+#include "../include/sha1.h"
+
+// Noyaux SHA1 internes pour le hachage en masse de blocs de même taille.
+// Multi-buffer SSE2 (4 voies) et AVX2 (8 voies) : chaque voie hache un bloc différent,
+// ce qui convient aux blocs de 4000 octets tous de même longueur (même remplissage).
+// SHA-NI : instructions SHA dédiées, un bloc à la fois.
+// Les résultats sont identiques à OpenSSL (même algorithme), les conteneurs existants restent valides.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA1_MB_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+static const uint32_t sha1_init[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+static uint32_t load_be32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void store_be32(uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+// Construit le(s) dernier(s) morceau(x) de 64 octets : reste des données, 0x80, zéros, longueur en bits
+// Retourne le nombre de morceaux (1 ou 2)
+static int sha1_tail(const uint8_t *data, size_t len, uint8_t tail[128])
+{
+  size_t rem = len % 64;
+  int chunks = (rem + 9 <= 64) ? 1 : 2;
+  memset(tail, 0, 128);
+  memcpy(tail, data + len - rem, rem);
+  tail[rem] = 0x80;
+  uint64_t bits = (uint64_t)len * 8;
+  for (int i = 0; i < 8; i++)
+    tail[chunks * 64 - 1 - i] = bits >> (8 * i);
+  return chunks;
+}
+
+#ifdef SHA1_MB_X86
+
+// ---------------------------------------------------------------------------
+// Multi-buffer : les macros de rondes sont génériques sur le type vecteur
+// ---------------------------------------------------------------------------
+
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+typedef uint32_t v8u32 __attribute__((vector_size(32)));
+
+// Déroulage complet des rondes : les indices de w deviennent constants et w reste en registres
+#define MB_UNROLL _Pragma("GCC unroll 20")
+#define MB_ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define MB_SCHED(w, t) (w[(t) & 15] = MB_ROL(w[((t) - 3) & 15] ^ w[((t) - 8) & 15] ^ w[((t) - 14) & 15] ^ w[(t) & 15], 1))
+#define MB_ROUND(a, b, c, d, e, f, k, wt)       \
+  do                                            \
+  {                                             \
+    __typeof__(a) tmp = MB_ROL(a, 5) + (f) + e + (k) + (wt); \
+    e = d;                                      \
+    d = c;                                      \
+    c = MB_ROL(b, 30);                          \
+    b = a;                                      \
+    a = tmp;                                    \
+  } while (0)
+
+// Compression d'un morceau de 64 octets par voie ; blk[l] pointe sur le morceau de la voie l
+// LOAD(w, blk) transpose les 16 mots big-endian de chaque voie dans w
+#define MB_COMPRESS(VEC, LOAD, st, blk)                                   \
+  do                                                                      \
+  {                                                                       \
+    VEC w[16];                                                            \
+    LOAD(w, blk);                                                         \
+    VEC a = st[0], b = st[1], c = st[2], d = st[3], e = st[4];            \
+    int t = 0;                                                            \
+    MB_UNROLL                                                             \
+    for (; t < 16; t++)                                                   \
+      MB_ROUND(a, b, c, d, e, (b & c) | (~b & d), 0x5A827999, w[t]);      \
+    MB_UNROLL                                                             \
+    for (; t < 20; t++)                                                   \
+      MB_ROUND(a, b, c, d, e, (b & c) | (~b & d), 0x5A827999, MB_SCHED(w, t)); \
+    MB_UNROLL                                                             \
+    for (; t < 40; t++)                                                   \
+      MB_ROUND(a, b, c, d, e, b ^ c ^ d, 0x6ED9EBA1, MB_SCHED(w, t));     \
+    MB_UNROLL                                                             \
+    for (; t < 60; t++)                                                   \
+      MB_ROUND(a, b, c, d, e, (b & c) | (b & d) | (c & d), 0x8F1BBCDC, MB_SCHED(w, t)); \
+    MB_UNROLL                                                             \
+    for (; t < 80; t++)                                                   \
+      MB_ROUND(a, b, c, d, e, b ^ c ^ d, 0xCA62C1D6, MB_SCHED(w, t));     \
+    st[0] += a;                                                           \
+    st[1] += b;                                                           \
+    st[2] += c;                                                           \
+    st[3] += d;                                                           \
+    st[4] += e;                                                           \
+  } while (0)
+
+// Hachage complet de LANES buffers de longueur len
+#define MB_HASH(VEC, LANES, LOAD, data, len, out)                               \
+  do                                                                      \
+  {                                                                       \
+    VEC st[5];                                                            \
+    for (int i = 0; i < 5; i++)                                           \
+      for (int l = 0; l < LANES; l++)                                     \
+        st[i][l] = sha1_init[i];                                          \
+    const uint8_t *blk[LANES];                                            \
+    for (size_t off = 0; off + 64 <= len; off += 64)                      \
+    {                                                                     \
+      for (int l = 0; l < LANES; l++)                                     \
+        blk[l] = (const uint8_t *)data[l] + off;                          \
+      MB_COMPRESS(VEC, LOAD, st, blk);                                   \
+    }                                                                     \
+    uint8_t tails[LANES][128];                                            \
+    int chunks = 0;                                                       \
+    for (int l = 0; l < LANES; l++)                                       \
+      chunks = sha1_tail(data[l], len, tails[l]);                         \
+    for (int c = 0; c < chunks; c++)                                      \
+    {                                                                     \
+      for (int l = 0; l < LANES; l++)                                     \
+        blk[l] = tails[l] + 64 * c;                                       \
+      MB_COMPRESS(VEC, LOAD, st, blk);                                   \
+    }                                                                     \
+    for (int l = 0; l < LANES; l++)                                       \
+      for (int i = 0; i < 5; i++)                                         \
+        store_be32(out[l] + 4 * i, st[i][l]);                             \
+  } while (0)
+
+__attribute__((target("sse2"))) static inline void mb_load_x4(v4u32 w[16], const uint8_t *const blk[4])
+{
+  for (int t = 0; t < 16; t++)
+    for (int l = 0; l < 4; l++)
+      w[t][l] = load_be32(blk[l] + 4 * t);
+}
+
+// Transposition 8x8 (deux fois) : w[t] reçoit le mot t des 8 voies, remis en big-endian
+__attribute__((target("avx2"))) static inline void mb_load_x8(v8u32 w[16], const uint8_t *const blk[8])
+{
+  const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  for (int h = 0; h < 2; h++)
+  {
+    __m256i r[8], t[8], u[8];
+    for (int l = 0; l < 8; l++)
+      r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(blk[l] + 32 * h)), bswap);
+    for (int l = 0; l < 8; l += 4)
+    {
+      t[l + 0] = _mm256_unpacklo_epi32(r[l + 0], r[l + 1]);
+      t[l + 1] = _mm256_unpackhi_epi32(r[l + 0], r[l + 1]);
+      t[l + 2] = _mm256_unpacklo_epi32(r[l + 2], r[l + 3]);
+      t[l + 3] = _mm256_unpackhi_epi32(r[l + 2], r[l + 3]);
+      u[l + 0] = _mm256_unpacklo_epi64(t[l + 0], t[l + 2]);
+      u[l + 1] = _mm256_unpackhi_epi64(t[l + 0], t[l + 2]);
+      u[l + 2] = _mm256_unpacklo_epi64(t[l + 1], t[l + 3]);
+      u[l + 3] = _mm256_unpackhi_epi64(t[l + 1], t[l + 3]);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+      w[8 * h + i] = (v8u32)_mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+      w[8 * h + i + 4] = (v8u32)_mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+  }
+}
+
+__attribute__((target("sse2"))) static void sha1_x4_sse2(const void *const data[4], size_t len, uint8_t *const out[4])
+{
+  MB_HASH(v4u32, 4, mb_load_x4, data, len, out);
+}
+
+__attribute__((target("avx2"))) static void sha1_x8_avx2(const void *const data[8], size_t len, uint8_t *const out[8])
+{
+  MB_HASH(v8u32, 8, mb_load_x8, data, len, out);
+}
+
+// ---------------------------------------------------------------------------
+// SHA-NI : 4 rondes par instruction sha1rnds4
+// ---------------------------------------------------------------------------
+
+// Prochaine valeur de W (4 mots) : m0 = W[t-16..], m1 = W[t-12..], m2 = W[t-8..], m3 = W[t-4..]
+#define NI_SCHED(m0, m1, m2, m3) (m0 = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(m0, m1), m2), m3))
+#define NI_ROUNDS(msg, f)                    \
+  do                                         \
+  {                                          \
+    e = _mm_sha1nexte_epu32(prev, msg);      \
+    prev = abcd;                             \
+    abcd = _mm_sha1rnds4_epu32(abcd, e, f);  \
+  } while (0)
+
+__attribute__((target("sha,sse4.1,ssse3"))) static void sha1_shani_compress(uint32_t state[5], const uint8_t *data, size_t chunks)
+{
+  const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+  __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+  for (; chunks > 0; chunks--, data += 64)
+  {
+    __m128i abcd_save = abcd, e0_save = e0, e, prev;
+    __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 0)), mask);
+    __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+    __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+    __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+
+    // Rondes 0-19
+    e = _mm_add_epi32(e0, m0);
+    prev = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+    NI_ROUNDS(m1, 0);
+    NI_ROUNDS(m2, 0);
+    NI_ROUNDS(m3, 0);
+    NI_ROUNDS(NI_SCHED(m0, m1, m2, m3), 0);
+    // Rondes 20-39
+    NI_ROUNDS(NI_SCHED(m1, m2, m3, m0), 1);
+    NI_ROUNDS(NI_SCHED(m2, m3, m0, m1), 1);
+    NI_ROUNDS(NI_SCHED(m3, m0, m1, m2), 1);
+    NI_ROUNDS(NI_SCHED(m0, m1, m2, m3), 1);
+    NI_ROUNDS(NI_SCHED(m1, m2, m3, m0), 1);
+    // Rondes 40-59
+    NI_ROUNDS(NI_SCHED(m2, m3, m0, m1), 2);
+    NI_ROUNDS(NI_SCHED(m3, m0, m1, m2), 2);
+    NI_ROUNDS(NI_SCHED(m0, m1, m2, m3), 2);
+    NI_ROUNDS(NI_SCHED(m1, m2, m3, m0), 2);
+    NI_ROUNDS(NI_SCHED(m2, m3, m0, m1), 2);
+    // Rondes 60-79
+    NI_ROUNDS(NI_SCHED(m3, m0, m1, m2), 3);
+    NI_ROUNDS(NI_SCHED(m0, m1, m2, m3), 3);
+    NI_ROUNDS(NI_SCHED(m1, m2, m3, m0), 3);
+    NI_ROUNDS(NI_SCHED(m2, m3, m0, m1), 3);
+    NI_ROUNDS(NI_SCHED(m3, m0, m1, m2), 3);
+
+    e0 = _mm_sha1nexte_epu32(prev, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+  state[4] = _mm_extract_epi32(e0, 3);
+}
+
+static void sha1_shani(const void *data, size_t len, uint8_t *out)
+{
+  uint32_t state[5];
+  uint8_t tail[128];
+  memcpy(state, sha1_init, sizeof(state));
+  sha1_shani_compress(state, data, len / 64);
+  int chunks = sha1_tail(data, len, tail);
+  sha1_shani_compress(state, tail, chunks);
+  for (int i = 0; i < 5; i++)
+    store_be32(out + 4 * i, state[i]);
+}
+
+static bool cpu_has_shani(void)
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return false;
+  return (ebx & (1u << 29)) && __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+}
+
+#endif // SHA1_MB_X86
+
+// ---------------------------------------------------------------------------
+// Sélection du noyau à l'exécution
+// ---------------------------------------------------------------------------
+
+bool sha1_kernel_supported(enum sha1_kernel kernel)
+{
+  switch (kernel)
+  {
+  case SHA1_KERNEL_OPENSSL:
+    return true;
+#ifdef SHA1_MB_X86
+  case SHA1_KERNEL_SSE2:
+    return __builtin_cpu_supports("sse2");
+  case SHA1_KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2");
+  case SHA1_KERNEL_SHANI:
+    return cpu_has_shani();
+#endif
+  default:
+    return false;
+  }
+}
+
+// Meilleur noyau pour le hachage par lots : AVX2 (8 voies), puis SHA-NI, sinon OpenSSL.
+// SSE2 (4 voies) reste plus lent que le code SSSE3 d'OpenSSL, il n'est utilisé que si on le force.
+enum sha1_kernel sha1_best_kernel(void)
+{
+  static const enum sha1_kernel order[] = {SHA1_KERNEL_AVX2, SHA1_KERNEL_SHANI};
+  for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+    if (sha1_kernel_supported(order[i]))
+      return order[i];
+  return SHA1_KERNEL_OPENSSL;
+}
+
+// Hache n buffers avec un noyau interne ; retourne false si le noyau doit être OpenSSL
+bool sha1_kernel_many(enum sha1_kernel kernel, const void *const data[], int n, size_t len, uint8_t *const out[])
+{
+#ifdef SHA1_MB_X86
+  int lanes = 0;
+  switch (kernel)
+  {
+  case SHA1_KERNEL_SHANI:
+    for (int i = 0; i < n; i++)
+      sha1_shani(data[i], len, out[i]);
+    return true;
+  case SHA1_KERNEL_AVX2:
+    lanes = 8;
+    break;
+  case SHA1_KERNEL_SSE2:
+    lanes = 4;
+    break;
+  default:
+    return false;
+  }
+  for (int i = 0; i < n; i += lanes)
+  {
+    // Dernier lot incomplet : les voies inutilisées rehachent le premier buffer, résultat ignoré
+    const void *lane_data[8];
+    uint8_t *lane_out[8];
+    uint8_t discard[8][20];
+    for (int l = 0; l < lanes; l++)
+    {
+      lane_data[l] = (i + l < n) ? data[i + l] : data[i];
+      lane_out[l] = (i + l < n) ? out[i + l] : discard[l];
+    }
+    if (lanes == 8)
+      sha1_x8_avx2(lane_data, len, lane_out);
+    else
+      sha1_x4_sse2(lane_data, len, lane_out);
+  }
+  return true;
+#else
+  (void)kernel;
+  (void)data;
+  (void)n;
+  (void)len;
+  (void)out;
+  return false;
+#endif
+}
@@ -1,4 +1,7 @@
 #include "utilitaires.h"
+#include "index_dossier.h"
+#include "cache_chemins.h"
+#include "verrous.h"
 
 // Gestion centralisée des erreurs
 int print_error(const char *msg)
@@ -32,35 +35,365 @@ void split_path(const char *path, char *parent_path, char *dir_name)
   }
 }
 
+// État de la session courante (conteneur ouvert par open_fs)
+static uint8_t *session_map = NULL;
+static bool session_ro = false; // Conteneur projeté en lecture seule (open_fs_ro)
+// Ancien conteneur ouvert en lecture seule, donc sans mise à niveau : file_size_hi et
+// triple_indirect_block sont encore dans la zone d'extensions et ne sont pas lus
+static bool session_size32 = false;
+static int32_t session_nbb = 0;
+static uint8_t *verified_blocks = NULL; // Bitset des blocs dont le SHA1 a déjà été vérifié
+static enum verify_policy verify_policy = VERIFY_ONCE;
+// Blocs modifiés dont le SHA1 sera recalculé une seule fois au commit
+static uint8_t *dirty_blocks = NULL;
+static int32_t *dirty_list = NULL;
+static int32_t dirty_count = 0;
+static int32_t dirty_capacity = 0;
+// Séries de blocs modifiés pendant la session, seules écrites par msync à la fermeture
+struct sync_range
+{
+  int32_t first;
+  int32_t count;
+};
+static struct sync_range *sync_ranges = NULL;
+static int32_t sync_count = 0;
+static int32_t sync_capacity = 0;
+static bool sync_all = false; // Un bloc modifié n'a pas pu être noté : toute la projection est écrite
+static enum sync_mode sync_mode = SYNC_FULL;
+// Résidence limitée : au plus resident_limit fenêtres de RESIDENT_WINDOW_BLOCKS blocs (64 Mo) restent
+// chargées ; la moins récemment utilisée est rendue au noyau par MADV_DONTNEED. La projection reste
+// valide (les pages restent dans le cache de pages), un nouvel accès la recharge
+#define RESIDENT_WINDOW_BLOCKS 16384
+#define RESIDENT_MAX_WINDOWS 1024
+static int32_t resident_limit = 0;                     // 0 = pas de limite
+static int32_t resident_windows[RESIDENT_MAX_WINDOWS]; // De la plus récente à la plus ancienne
+static int32_t resident_count = 0;
+// Nombre de bits libres de la zone de données par bloc de bitmap (-1 = pas encore compté)
+static int32_t *bitmap_free = NULL;
+static int32_t session_nb1 = 0;
+// Blocs déjà alloués d'avance pour les écritures en cours, consommés par alloc_data_block dans l'ordre
+static int32_t *reserved_blocks = NULL;
+static int32_t reserved_head = 0;
+static int32_t reserved_count = 0;
+static int32_t reserved_capacity = 0;
+
+void set_verify_policy(enum verify_policy policy)
+{
+  verify_policy = policy;
+}
+
+enum verify_policy get_verify_policy(void)
+{
+  return verify_policy;
+}
+
+void set_sync_mode(enum sync_mode mode)
+{
+  sync_mode = mode;
+}
+
+enum sync_mode get_sync_mode(void)
+{
+  return sync_mode;
+}
+
+void set_resident_limit(int32_t mb)
+{
+  // Deux fenêtres au moins : un lot de lecture peut chevaucher une frontière
+  int32_t n = mb <= 0 ? 0 : (mb + 63) / 64;
+  resident_limit = n == 0 ? 0 : n < 2 ? 2 : n > RESIDENT_MAX_WINDOWS ? RESIDENT_MAX_WINDOWS : n;
+}
+
+bool resident_limited(void)
+{
+  return resident_limit > 0;
+}
+
+// Accès au bloc b : sa fenêtre devient la plus récente, la plus ancienne est rendue si besoin
+static void resident_touch(uint8_t *map, int64_t b)
+{
+  if (resident_limit == 0 || map != session_map || b < 0 || b >= session_nbb)
+    return;
+  int32_t w = b / RESIDENT_WINDOW_BLOCKS;
+  if (resident_count > 0 && resident_windows[0] == w)
+    return;
+  int32_t i = 0;
+  while (i < resident_count && resident_windows[i] != w)
+    i++;
+  if (i == resident_count)
+  {
+    if (resident_count == resident_limit)
+    {
+      int64_t first = (int64_t)resident_windows[--resident_count] * RESIDENT_WINDOW_BLOCKS;
+      int64_t n = session_nbb - first < RESIDENT_WINDOW_BLOCKS ? session_nbb - first : RESIDENT_WINDOW_BLOCKS;
+      madvise(session_map + first * 4096, n * 4096, MADV_DONTNEED);
+      i = resident_count;
+    }
+    resident_count++;
+  }
+  memmove(&resident_windows[1], &resident_windows[0], i * sizeof(int32_t));
+  resident_windows[0] = w;
+}
+
+// Note le bloc b comme modifié, en prolongeant la dernière série quand il la suit
+static void sync_range_add(int32_t b)
+{
+  if (sync_count > 0)
+  {
+    struct sync_range *r = &sync_ranges[sync_count - 1];
+    if (b >= r->first && b <= r->first + r->count)
+    {
+      if (b == r->first + r->count)
+        r->count++;
+      return;
+    }
+  }
+  if (sync_count == sync_capacity)
+  {
+    int32_t capacity = sync_capacity ? 2 * sync_capacity : 64;
+    struct sync_range *ranges = realloc(sync_ranges, capacity * sizeof(struct sync_range));
+    if (!ranges)
+    {
+      sync_all = true;
+      return;
+    }
+    sync_ranges = ranges;
+    sync_capacity = capacity;
+  }
+  sync_ranges[sync_count].first = b;
+  sync_ranges[sync_count++].count = 1;
+}
+
+static int sync_range_cmp(const void *a, const void *b)
+{
+  int32_t x = ((const struct sync_range *)a)->first, y = ((const struct sync_range *)b)->first;
+  return (x > y) - (x < y);
+}
+
+// Écrit les pages modifiées selon le mode de durabilité : les séries notées, fusionnées une fois
+// triées, ou toute la projection si elles ne sont pas connues (tracked faux ou notation incomplète)
+static void sync_ranges_flush(uint8_t *map, size_t size, bool tracked)
+{
+  int flags = sync_mode == SYNC_ASYNC ? MS_ASYNC : MS_SYNC;
+  if (sync_mode != SYNC_NONE && (!tracked || sync_all))
+    msync(map, size, flags);
+  else if (sync_mode != SYNC_NONE && sync_count > 0)
+  {
+    qsort(sync_ranges, sync_count, sizeof(struct sync_range), sync_range_cmp);
+    int64_t lo = sync_ranges[0].first, hi = lo + sync_ranges[0].count;
+    for (int32_t i = 1; i <= sync_count; i++)
+    {
+      if (i < sync_count && sync_ranges[i].first <= hi)
+      {
+        if (sync_ranges[i].first + sync_ranges[i].count > hi)
+          hi = sync_ranges[i].first + sync_ranges[i].count;
+        continue;
+      }
+      msync(map + lo * 4096, (size_t)(hi - lo) * 4096, flags);
+      if (i < sync_count)
+      {
+        lo = sync_ranges[i].first;
+        hi = lo + sync_ranges[i].count;
+      }
+    }
+  }
+  sync_count = 0;
+  sync_all = false;
+}
+
+static bool is_dirty(uint8_t *map, int32_t b)
+{
+  return map == session_map && b >= 0 && b < session_nbb && (dirty_blocks[b / 8] & (1 << (b % 8)));
+}
+
+// Vérifie le SHA1 d'un bloc selon la politique de vérification courante
+static void verify_block(uint8_t *map, int32_t b, const void *blk)
+{
+  // Un bloc modifié a un SHA1 en attente de recalcul : on fait confiance à son contenu
+  if (verify_policy == VERIFY_FSCK_ONLY || is_dirty(map, b))
+    return;
+  if (verify_policy == VERIFY_ONCE && map == session_map && b >= 0 && b < session_nbb)
+  {
+    if (verified_blocks[b / 8] & (1 << (b % 8)))
+      return;
+    if (check_sha1(blk, 4000, (const uint8_t *)blk + 4000))
+      verified_blocks[b / 8] |= (1 << (b % 8));
+    return;
+  }
+  check_sha1(blk, 4000, (const uint8_t *)blk + 4000);
+}
+
+// Compare les SHA1 calculés d'un lot ; un bloc correct est marqué vérifié, un bloc faux est signalé
+static void verify_batch(uint8_t *map, const int32_t *idx, const void *const data[], uint8_t *const out[], int m)
+{
+  calcul_sha1_many(data, m, 4000, out);
+  for (int k = 0; k < m; k++)
+  {
+    int32_t b = idx[k];
+    if (memcmp(out[k], (const uint8_t *)data[k] + 4000, 20) != 0)
+      check_sha1(data[k], 4000, (const uint8_t *)data[k] + 4000); // Affiche l'erreur
+    else if (verify_policy == VERIFY_ONCE && map == session_map && b >= 0 && b < session_nbb)
+      verified_blocks[b / 8] |= (1 << (b % 8));
+  }
+}
+
+void verify_blocks(uint8_t *map, const int32_t *blocks, int n)
+{
+  if (verify_policy == VERIFY_FSCK_ONLY)
+    return;
+  const void *data[64];
+  uint8_t sha1[64][20];
+  uint8_t *out[64];
+  int32_t idx[64];
+  int m = 0;
+  for (int k = 0; k < n; k++)
+  {
+    int32_t b = blocks[k];
+    resident_touch(map, b);
+    if (is_dirty(map, b))
+      continue;
+    if (verify_policy == VERIFY_ONCE && map == session_map && b >= 0 && b < session_nbb &&
+        (verified_blocks[b / 8] & (1 << (b % 8))))
+      continue;
+    data[m] = map + (int64_t)b * 4096;
+    out[m] = sha1[m];
+    idx[m++] = b;
+    if (m == 64)
+    {
+      verify_batch(map, idx, data, out, m);
+      m = 0;
+    }
+  }
+  if (m > 0)
+    verify_batch(map, idx, data, out, m);
+}
+
+// Oublie la vérification d'un bloc (il sera revérifié au prochain accès)
+void invalidate_block(const void *blk)
+{
+  const uint8_t *p = blk;
+  if (!session_map || p < session_map || p >= session_map + (int64_t)session_nbb * 4096)
+    return;
+  int32_t b = (p - session_map) / 4096;
+  verified_blocks[b / 8] &= ~(1 << (b % 8));
+}
+
+// Marque un bloc comme modifié : son SHA1 (qui suit toujours les 4000 octets de contenu)
+// sera recalculé par commit_dirty_blocks. Hors session, le SHA1 est recalculé immédiatement.
+void update_block_sha1(void *blk)
+{
+  uint8_t *p = blk;
+  if (!session_map || p < session_map || p >= session_map + (int64_t)session_nbb * 4096)
+  {
+    calcul_sha1(p, 4000, p + 4000);
+    return;
+  }
+  // Le SHA1 écrit (tout de suite ou au commit) est juste : inutile de le revérifier ensuite
+  int32_t b = (p - session_map) / 4096;
+  verified_blocks[b / 8] |= (1 << (b % 8));
+  if (dirty_blocks[b / 8] & (1 << (b % 8)))
+    return;
+  if (dirty_count == dirty_capacity)
+  {
+    int32_t capacity = dirty_capacity ? 2 * dirty_capacity : 64;
+    int32_t *list = realloc(dirty_list, capacity * sizeof(int32_t));
+    if (!list)
+    {
+      // Plus de mémoire pour différer : on recalcule tout de suite
+      calcul_sha1(p, 4000, p + 4000);
+      sync_all = true;
+      return;
+    }
+    dirty_list = list;
+    dirty_capacity = capacity;
+  }
+  dirty_blocks[b / 8] |= (1 << (b % 8));
+  dirty_list[dirty_count++] = b;
+}
+
+// Recalcule une seule fois le SHA1 de chaque bloc modifié depuis le dernier commit
+void commit_dirty_blocks(void)
+{
+  const void *data[64];
+  uint8_t *out[64];
+  int n = 0;
+  for (int32_t i = 0; i < dirty_count; i++)
+  {
+    int32_t b = dirty_list[i];
+    uint8_t *p = session_map + (int64_t)b * 4096;
+    data[n] = p;
+    out[n++] = p + 4000;
+    dirty_blocks[b / 8] &= ~(1 << (b % 8));
+    sync_range_add(b);
+    if (n == 64 || i == dirty_count - 1)
+    {
+      calcul_sha1_many(data, n, 4000, out);
+      n = 0;
+    }
+  }
+  dirty_count = 0;
+}
+
+static void release_reserved_blocks(void);
+
+// Termine la session courante (les blocs modifiés sont recalculés avant de rendre les verrous)
+static void end_session(void)
+{
+  dentry_cache_clear();
+  release_reserved_blocks();
+  commit_dirty_blocks();
+  lock_table_close();
+  free(verified_blocks);
+  free(dirty_blocks);
+  free(bitmap_free);
+  free(reserved_blocks);
+  reserved_blocks = NULL;
+  reserved_head = reserved_count = reserved_capacity = 0;
+  verified_blocks = NULL;
+  dirty_blocks = NULL;
+  bitmap_free = NULL;
+  session_map = NULL;
+  session_ro = false;
+  session_size32 = false;
+  resident_count = 0;
+  session_nbb = 0;
+  session_nb1 = 0;
+}
+
 // Helpers pour accéder aux blocs
 struct pignoufs *get_superblock(uint8_t *map)
 {
   struct pignoufs *sb = (struct pignoufs *)map;
-  check_sha1(sb, 4000, sb->sha1);
+  resident_touch(map, 0);
+  verify_block(map, 0, sb);
   return sb;
 }
 struct bitmap_block *get_bitmap_block(uint8_t *map, int32_t b)
 {
   struct bitmap_block *bb = (struct bitmap_block *)(map + (int64_t)b * 4096);
-  check_sha1(bb->bits, 4000, bb->sha1);
+  resident_touch(map, b);
+  verify_block(map, b, bb);
   return bb;
 }
 struct inode *get_inode(uint8_t *map, int32_t b)
 {
   struct inode *in = (struct inode *)(map + (int64_t)(b) * 4096);
-  check_sha1(in, 4000, in->sha1);
+  resident_touch(map, b);
+  verify_block(map, b, in);
   return in;
 }
 struct data_block *get_data_block(uint8_t *map, int32_t b)
 {
   struct data_block *db = (struct data_block *)(map + (int64_t)b * 4096);
-  check_sha1(db->data, 4000, db->sha1);
+  resident_touch(map, b);
+  verify_block(map, b, db);
   return db;
 }
 struct address_block *get_address_block(uint8_t *map, int32_t b)
 {
   struct address_block *ab = (struct address_block *)(map + (int64_t)b * 4096);
-  check_sha1(ab->addresses, 4000, ab->sha1);
+  resident_touch(map, b);
+  verify_block(map, b, ab);
   return ab;
 }
 
@@ -78,28 +411,28 @@ void decremente_lbl(uint8_t *map)
 {
   struct pignoufs *sb = get_superblock(map);
   sb->nb_l--;
-  calcul_sha1(map, 4000, map + 4000);
+  update_block_sha1(sb);
 }
 
 void incremente_lbl(uint8_t *map)
 {
   struct pignoufs *sb = get_superblock(map);
   sb->nb_l++;
-  calcul_sha1(map, 4000, map + 4000);
+  update_block_sha1(sb);
 }
 
 void decrement_nb_f(uint8_t *map)
 {
   struct pignoufs *sb = get_superblock(map);
   sb->nb_f--;
-  calcul_sha1(map, 4000, map + 4000);
+  update_block_sha1(sb);
 }
 
 void increment_nb_f(uint8_t *map)
 {
   struct pignoufs *sb = get_superblock(map);
   sb->nb_f++;
-  calcul_sha1(map, 4000, map + 4000);
+  update_block_sha1(sb);
 }
 
 bool check_bitmap_bit(uint8_t *map, int32_t blknum)
@@ -119,7 +452,8 @@ void init_inode(struct inode *in, const char *name, bool type)
                       | (1 << 2)      /* permission d'écriture */
                       | (0 << 3)      /* verrouillage en lecture */
                       | (0 << 4)      /* verrouillage en écriture */
-                      | (type << 5)); /* 0 fichier, 1 répertoire */
+                      | (type << 5)   /* 0 fichier, 1 répertoire */
+                      | (type ? 0 : INODE_EXTENTS)); /* fichier : blocs décrits par extents */
   in->file_size = TO_LE32(0);
   in->creation_time = TO_LE32(now);
   in->access_time = TO_LE32(now);
@@ -131,16 +465,167 @@ void init_inode(struct inode *in, const char *name, bool type)
     in->direct_blocks[i] = TO_LE32(-1);
   }
   in->double_indirect_block = TO_LE32(-1);
+  in->dir_index = TO_LE32(0);
+  in->dir_free = TO_LE32(0);
+  in->parent = TO_LE32(0);
+  in->file_size_hi = TO_LE32(0);
+  in->triple_indirect_block = TO_LE32(0);
   memset(in->extensions, 0, sizeof in->extensions);
-  calcul_sha1(in, 4000, in->sha1);
+  update_block_sha1(in);
   in->type = TO_LE32(3);
 }
 
+// Vrai pour un inode de la session courante si celle-ci ignore les champs 64 bits
+static bool inode_size32(const struct inode *in)
+{
+  const uint8_t *p = (const uint8_t *)in;
+  return session_size32 && p >= session_map && p < session_map + (int64_t)session_nbb * 4096;
+}
+
+uint64_t inode_size(const struct inode *in)
+{
+  if (inode_size32(in))
+    return FROM_LE32(in->file_size);
+  return (uint64_t)FROM_LE32(in->file_size_hi) << 32 | FROM_LE32(in->file_size);
+}
+
+void set_inode_size(struct inode *in, uint64_t size)
+{
+  in->file_size = TO_LE32((uint32_t)size);
+  in->file_size_hi = TO_LE32((uint32_t)(size >> 32));
+}
+
+// Mise à niveau d'un ancien conteneur : crée l'inode racine et y rattache les entrées de profondeur 0.
+// Sans inode libre (ou sans blocs pour les pages d'une grande racine), le conteneur reste sans racine.
+static void upgrade_root(uint8_t *map)
+{
+  int32_t nb1, nbi, nba, nbb;
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int32_t n = 0;
+  for (int32_t i = 0; i < nbi; i++)
+  {
+    struct inode *in = get_inode(map, 1 + nb1 + i);
+    if ((FROM_LE32(in->flags) & 1) && FROM_LE32(in->profondeur) == 0)
+      n++;
+  }
+  // Au-delà de 900 entrées, la racine a besoin de pages de cases
+  if (n > 900 && (int32_t)FROM_LE32(get_superblock(map)->nb_l) < 1 + (n - 900 + 999) / 1000)
+    return;
+  int32_t root = alloc_inode(map);
+  if (root < 0)
+    return;
+  struct inode *in = get_inode(map, root);
+  init_inode(in, "", true);
+  in->profondeur = TO_LE32(-1);
+  bitmap_alloc(map, root);
+  update_block_sha1(in);
+  increment_nb_f(map);
+  for (int32_t i = 0; i < nbi; i++)
+  {
+    struct inode *child = get_inode(map, 1 + nb1 + i);
+    if (1 + nb1 + i != root && (FROM_LE32(child->flags) & 1) && FROM_LE32(child->profondeur) == 0)
+      add_inode(map, in, 1 + nb1 + i);
+  }
+  struct pignoufs *sb = get_superblock(map);
+  sb->root_inode = TO_LE32(root);
+  sb->features = TO_LE32(FROM_LE32(sb->features) | PFS_FEATURE_ROOT);
+  update_block_sha1(sb);
+}
+
+// Renseigne le parent de chaque enfant d'un répertoire, récursivement
+static void set_parents(uint8_t *map, int32_t dir, int depth)
+{
+  if (depth > 1000)
+    return;
+  struct dir_iter it;
+  dir_iter_init(&it, map, get_inode(map, dir));
+  int32_t child;
+  while ((child = dir_iter_next(&it)) >= 0)
+  {
+    struct inode *in = get_inode(map, child);
+    if ((int32_t)FROM_LE32(in->parent) != dir)
+    {
+      in->parent = TO_LE32(dir);
+      update_block_sha1(in);
+    }
+    if ((FROM_LE32(in->flags) >> 5) & 1)
+      set_parents(map, child, depth + 1);
+  }
+}
+
+// Mise à niveau d'un conteneur à racine sans pointeurs vers les parents : un parcours depuis la racine
+static void upgrade_parents(uint8_t *map)
+{
+  struct pignoufs *sb = get_superblock(map);
+  set_parents(map, FROM_LE32(sb->root_inode), 0);
+  sb->features = TO_LE32(FROM_LE32(sb->features) | PFS_FEATURE_PARENT);
+  update_block_sha1(sb);
+}
+
+// Mise à niveau vers les tailles 64 bits : les nouveaux champs de l'inode étaient dans la zone
+// d'extensions, on ne réécrit que les inodes où elle n'était pas nulle
+static void upgrade_size64(uint8_t *map)
+{
+  int32_t nb1, nbi, nba, nbb;
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  for (int32_t i = 1 + nb1; i < 1 + nb1 + nbi; i++)
+  {
+    // Lecture directe : pas de vérification du SHA1 de chaque inode pour une mise à niveau
+    struct inode *in = (struct inode *)(map + (int64_t)i * 4096);
+    if (in->file_size_hi != 0 || in->triple_indirect_block != 0)
+    {
+      in->file_size_hi = TO_LE32(0);
+      in->triple_indirect_block = TO_LE32(0);
+      update_block_sha1(in);
+    }
+  }
+  struct pignoufs *sb = get_superblock(map);
+  sb->features = TO_LE32(FROM_LE32(sb->features) | PFS_FEATURE_SIZE64);
+  update_block_sha1(sb);
+}
+
+// Profil imposé en ligne de commande (-1 : celui choisi par la commande)
+static int access_override = -1;
+
+void set_access_override(enum access_profile profile)
+{
+  access_override = profile;
+}
+
+enum access_profile effective_access_profile(enum access_profile profile)
+{
+  return access_override >= 0 ? (enum access_profile)access_override : profile;
+}
+
+// Au plus 64 Mo de métadonnées (bitmap puis table des inodes) demandés d'avance
+#define HOT_REGION_MAX_BLOCKS 16384
+
+// Conseils au noyau selon le profil d'accès, sur toute la projection. Le bitmap et la table des
+// inodes, relus par toutes les commandes, gardent la lecture anticipée normale et sont demandés d'avance
+static void apply_access_profile(uint8_t *map, size_t size, enum access_profile profile)
+{
+  if (profile == ACCESS_RANDOM)
+    madvise(map, size, MADV_RANDOM);
+  else if (profile == ACCESS_SEQUENTIAL || profile == ACCESS_SCAN)
+    madvise(map, size, MADV_SEQUENTIAL);
+  if (size < 4096)
+    return;
+  const struct pignoufs *sb = (const struct pignoufs *)map;
+  int64_t hot = FROM_LE32(sb->nb_b) - FROM_LE32(sb->nb_a); // Superbloc, bitmap et inodes
+  if (hot <= 0 || hot > (int64_t)(size / 4096))
+    return;
+  if (hot > HOT_REGION_MAX_BLOCKS)
+    hot = HOT_REGION_MAX_BLOCKS;
+  if (profile != ACCESS_DEFAULT)
+    madvise(map, hot * 4096, MADV_NORMAL);
+  madvise(map, hot * 4096, MADV_WILLNEED);
+}
 
-// Ouverture du système de fichiers et projection en mémoire
-int open_fs(const char *fsname, uint8_t **map, size_t *size)
+// Ouverture et projection, en lecture seule ou non
+static int open_fs_mode(const char *fsname, uint8_t **map, size_t *size, bool ro, enum access_profile profile)
 {
-  int fd = open(fsname, O_RDWR);
+  profile = effective_access_profile(profile);
+  int fd = open(fsname, ro ? O_RDONLY : O_RDWR);
   if (fd < 0)
   {
     fatal_error("open: erreur d'ouverture du fichier");
@@ -153,20 +638,91 @@ int open_fs(const char *fsname, uint8_t **map, size_t *size)
     return -1;
   }
   *size = st.st_size;
-  *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (map == MAP_FAILED)
+  *map = mmap(NULL, st.st_size, ro ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (*map == MAP_FAILED)
   {
     print_error("mmap: erreur");
     close(fd);
     return -1;
   }
+  apply_access_profile(*map, *size, profile);
+  // Nouvelle session : aucun bloc n'est encore vérifié ni modifié.
+  // Une session précédente jamais fermée est terminée ici, et à la sortie du processus.
+  static bool atexit_registered = false;
+  if (!atexit_registered)
+  {
+    atexit(end_session);
+    atexit_registered = true;
+  }
+  end_session();
+  // Verrous de blocs partagés avec les autres processus du conteneur (fcntl si indisponible)
+  if (!lock_table_open(fd, st.st_size / 4096))
+  {
+    print_error("Erreur: table des verrous utilisée par d'autres processus mais inaccessible");
+    munmap(*map, *size);
+    close(fd);
+    return -1;
+  }
+  // Séries d'une session jamais fermée : elles concernaient une autre projection
+  sync_count = 0;
+  sync_all = false;
+  session_map = *map;
+  session_ro = ro;
+  session_nbb = st.st_size / 4096;
+  verified_blocks = calloc((session_nbb + 7) / 8, 1);
+  dirty_blocks = calloc((session_nbb + 7) / 8, 1);
+  if (!verified_blocks || !dirty_blocks)
+  {
+    fatal_error("open_fs: erreur d'allocation mémoire");
+  }
+  // Compteurs de blocs libres par bloc de bitmap, calculés à la demande
+  const struct pignoufs *sb = (const struct pignoufs *)*map;
+  int32_t nb1 = FROM_LE32(sb->nb_b) - 1 - FROM_LE32(sb->nb_i) - FROM_LE32(sb->nb_a);
+  if (*size >= 4096 && nb1 > 0 && nb1 < session_nbb)
+  {
+    bitmap_free = malloc(nb1 * sizeof(int32_t));
+    if (!bitmap_free)
+      fatal_error("open_fs: erreur d'allocation mémoire");
+    for (int32_t k = 0; k < nb1; k++)
+      bitmap_free[k] = -1;
+    session_nb1 = nb1;
+  }
+  // Un ancien format est mis à niveau par les commandes qui écrivent ; en lecture seule, il est
+  // lu tel quel (racine et parents retrouvés par parcours, tailles sur 32 bits)
+  if (ro)
+    session_size32 = *size >= 4096 && !(FROM_LE32(sb->features) & PFS_FEATURE_SIZE64);
+  else if (*size >= 4096 && !(FROM_LE32(sb->features) & PFS_FEATURE_ROOT))
+    upgrade_root(*map);
+  if (!ro && *size >= 4096 && (FROM_LE32(sb->features) & PFS_FEATURE_ROOT) &&
+      !(FROM_LE32(sb->features) & PFS_FEATURE_PARENT))
+    upgrade_parents(*map);
+  if (!ro && *size >= 4096 && !(FROM_LE32(sb->features) & PFS_FEATURE_SIZE64))
+    upgrade_size64(*map);
+  // Mise à niveau faite : ses SHA1 sont écrits avant que la commande (fsck compris) ne lise les blocs
+  commit_dirty_blocks();
   return fd;
 }
 
+int open_fs(const char *fsname, uint8_t **map, size_t *size, enum access_profile profile)
+{
+  return open_fs_mode(fsname, map, size, false, profile);
+}
+
+int open_fs_ro(const char *fsname, uint8_t **map, size_t *size, enum access_profile profile)
+{
+  return open_fs_mode(fsname, map, size, true, profile);
+}
+
 // Fermeture du système de fichiers et synchronisation
 void close_fs(int fd, uint8_t *map, size_t size)
 {
-  msync(map, size, MS_SYNC);
+  // Rien à écrire pour une projection en lecture seule
+  bool tracked = map == session_map;
+  bool ro = tracked && session_ro;
+  if (tracked)
+    end_session();
+  if (!ro)
+    sync_ranges_flush(map, size, tracked);
   int er = munmap(map, size);
   if (er < 0)
   {
@@ -175,18 +731,132 @@ void close_fs(int fd, uint8_t *map, size_t size)
   close(fd);
 }
 
+// Met à jour le compteur de blocs libres du bloc de bitmap contenant blknum (zone de données seulement)
+static void bitmap_count_adjust(uint8_t *map, int32_t blknum, int delta)
+{
+  int32_t k = blknum / 32000;
+  if (map != session_map || !bitmap_free || k >= session_nb1 || bitmap_free[k] < 0)
+    return;
+  int32_t nb1, nbi, nba, nbb;
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  if (blknum >= 1 + nb1 + nbi && blknum < nbb)
+    bitmap_free[k] += delta;
+}
+
 void bitmap_alloc(uint8_t *map, int32_t blknum)
 {
   int32_t idx = blknum / 32000;
   int32_t bit = blknum % 32000;
   struct bitmap_block *bb = get_bitmap_block(map, idx + 1);
+  if (bb->bits[bit / 8] & (1 << (bit % 8)))
+    bitmap_count_adjust(map, blknum, -1);
   bb->bits[bit / 8] &= ~(1 << (bit % 8));
-  calcul_sha1(bb->bits, 4000, bb->sha1);
+  update_block_sha1(bb);
   bb->type = TO_LE32(2);
 }
 
+// Mot de 64 bits du bitmap (bit i du mot = bit 64 * w + i du bloc)
+static uint64_t bitmap_word(const struct bitmap_block *bb, int32_t w)
+{
+  uint64_t word;
+  memcpy(&word, bb->bits + w * 8, 8);
+  return le64toh(word);
+}
+
+// Masque des bits [lo, hi) du mot w, lo et hi relatifs au bloc de bitmap
+static uint64_t bitmap_word_mask(int32_t w, int32_t lo, int32_t hi)
+{
+  uint64_t mask = ~0ULL;
+  if (lo > w * 64)
+    mask &= ~0ULL << (lo - w * 64);
+  if (hi < w * 64 + 64)
+    mask &= ~0ULL >> (w * 64 + 64 - hi);
+  return mask;
+}
+
+// Premier bloc libre de [from, to) dans le bloc de bitmap k, -1 s'il n'y en a pas
+static int32_t bitmap_scan(const struct bitmap_block *bb, int32_t k, int32_t from, int32_t to)
+{
+  int32_t lo = from - k * 32000, hi = to - k * 32000;
+  for (int32_t w = lo / 64; w * 64 < hi; w++)
+  {
+    uint64_t word = bitmap_word(bb, w) & bitmap_word_mask(w, lo, hi);
+    if (word)
+      return k * 32000 + w * 64 + __builtin_ctzll(word);
+  }
+  return -1;
+}
+
+// Nombre de blocs libres de la zone de données suivis par le bloc de bitmap k (-1 si inconnu)
+static int32_t bitmap_free_count(uint8_t *map, int32_t k)
+{
+  if (map != session_map || !bitmap_free || k >= session_nb1)
+    return -1;
+  if (bitmap_free[k] < 0)
+  {
+    int32_t nb1, nbi, nba, nbb;
+    get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+    int32_t lo = (1 + nb1 + nbi > k * 32000 ? 1 + nb1 + nbi : k * 32000) - k * 32000;
+    int32_t hi = (nbb < (k + 1) * 32000 ? nbb : (k + 1) * 32000) - k * 32000;
+    const struct bitmap_block *bb = get_bitmap_block(map, k + 1);
+    int32_t count = 0;
+    for (int32_t w = lo / 64; w * 64 < hi; w++)
+      count += __builtin_popcountll(bitmap_word(bb, w) & bitmap_word_mask(w, lo, hi));
+    bitmap_free[k] = lo < hi ? count : 0;
+  }
+  return bitmap_free[k];
+}
+
+// Premier bloc libre de [from, to), en sautant les blocs de bitmap entièrement alloués
+static int32_t bitmap_find_free(uint8_t *map, int32_t from, int32_t to)
+{
+  while (from < to)
+  {
+    int32_t k = from / 32000;
+    int32_t end = (k + 1) * 32000 < to ? (k + 1) * 32000 : to;
+    if (bitmap_free_count(map, k) != 0)
+    {
+      int32_t b = bitmap_scan(get_bitmap_block(map, k + 1), k, from, end);
+      if (b >= 0)
+        return b;
+    }
+    from = end;
+  }
+  return -1;
+}
+
+// Inode du répertoire racine, ou -1 pour un ancien conteneur sans racine
+int32_t get_root_inode(uint8_t *map)
+{
+  struct pignoufs *sb = get_superblock(map);
+  if (!(FROM_LE32(sb->features) & PFS_FEATURE_ROOT))
+    return -1;
+  return FROM_LE32(sb->root_inode);
+}
+
+// Rattache une entrée de premier niveau à la racine (sans effet sur un ancien conteneur)
+void add_root_entry(uint8_t *map, int32_t val)
+{
+  int32_t root = get_root_inode(map);
+  if (root >= 0)
+    add_inode(map, get_inode(map, root), val);
+}
+
+// Détache une entrée de premier niveau de la racine (sans effet sur un ancien conteneur)
+void delete_root_entry(uint8_t *map, int32_t val)
+{
+  int32_t root = get_root_inode(map);
+  if (root >= 0)
+    delete_separte_inode(map, get_inode(map, root), val);
+}
+
 int find_inode_racine(uint8_t *map, int32_t nb1, int32_t nbi, const char *name, bool type)
 {
+  // La racine est un répertoire comme les autres : recherche indexée dans ses enfants
+  int32_t root = get_root_inode(map);
+  if (root >= 0)
+    return find_file_folder_from_inode(map, get_inode(map, root), name, type);
+  // Ancien conteneur : parcours de toute la table des inodes
   int val = -1;
   for (int i = 0; i < nbi; i++)
   {
@@ -201,41 +871,55 @@ int find_inode_racine(uint8_t *map, int32_t nb1, int32_t nbi, const char *name,
 
 int find_file_folder_from_inode(uint8_t *map, struct inode *in, const char *name, bool type)
 {
-  int val = -1;
-  for (int i = 0; i < 900; i++)
+  // Répertoire indexé : une recherche par hachage suffit
+  int val = dir_index_lookup(map, in, name, type);
+  if (val != -2)
+    return val;
+  struct dir_iter it;
+  dir_iter_init(&it, map, in);
+  while ((val = dir_iter_next(&it)) >= 0)
   {
-    if (in->direct_blocks[i] != -1)
+    struct inode *child_inode = get_inode(map, val);
+    if ((FROM_LE32(child_inode->flags) & 1) && strcmp(child_inode->filename, name) == 0 && ((FROM_LE32(child_inode->flags) >> 5) & 1) == type)
     {
-      struct inode *child_inode = get_inode(map, FROM_LE32(in->direct_blocks[i]));
-      if ((FROM_LE32(child_inode->flags) & 1) && strcmp(child_inode->filename, name) == 0 && ((FROM_LE32(child_inode->flags) >> 5) & 1) == type)
-      {
-        return FROM_LE32(in->direct_blocks[i]);
-      }
+      return val;
     }
   }
-  return val;
+  return -1;
 }
 
 int find_inode_folder(uint8_t *map, int32_t nb1, int32_t nbi, const char *name)
 {
+  // Chemin complet déjà résolu dans la session
+  int val = dentry_cache_lookup(map, name);
+  if (val != -1)
+    return val;
+
   int cpt = 0;
   char tmp[256];
   strncpy(tmp, name, sizeof(tmp));
   tmp[sizeof(tmp) - 1] = '\0';
   char *token = strtok(tmp, "/");
   struct inode *parent = NULL;
-  int val = -1;
+  // Préfixe déjà parcouru, clé du cache pour chaque répertoire intermédiaire
+  char prefix[256] = "";
+  size_t plen = 0;
 
   while (token != NULL)
   {
-    if (parent == NULL)
+    plen += snprintf(prefix + plen, sizeof(prefix) - plen, plen ? "/%s" : "%s", token);
+    if (plen >= sizeof(prefix))
+      plen = sizeof(prefix) - 1;
+    int cached = dentry_cache_lookup(map, prefix);
+    if (cached != -1)
+      val = cached;
+    else if (parent == NULL)
     {
       val = find_inode_racine(map, nb1, nbi, token, true);
       if (val == -1)
       {
         return val;
       }
-      parent = get_inode(map, val);
     }
     else
     {
@@ -245,200 +929,802 @@ int find_inode_folder(uint8_t *map, int32_t nb1, int32_t nbi, const char *name)
         print_error("Erreur: le répertoire n'existe pas");
         return -1;
       }
-      parent = get_inode(map, val);
     }
+    if (cached == -1)
+      dentry_cache_insert(prefix, val);
+    parent = get_inode(map, val);
     cpt++;
     token = strtok(NULL, "/");
   }
   return val;
 }
 
-void add_inode(struct inode *in, int val)
+// Bloc d'adresses vide (toutes les cases à -1) du type donné, -1 s'il n'y a plus de place
+static int32_t new_address_block(uint8_t *map, int32_t type)
 {
-  for (int i = 0; i < 900; i++)
-  {
-    if ((int)FROM_LE32(in->direct_blocks[i]) == -1)
-    {
-      in->direct_blocks[i] = TO_LE32(val);
-      break;
-    }
-    if (i == 899)
-    {
-      fatal_error("Erreur: pas de place pour ajouter un inode");
-      return;
-    }
-  }
-  in->modification_time = TO_LE32(time(NULL));
-  calcul_sha1(in, 4000, in->sha1);
+  int32_t b = alloc_data_block(map);
+  if (b < 0)
+    return -1;
+  struct address_block *ab = get_address_block(map, b);
+  memset(ab->addresses, 0xff, sizeof(ab->addresses));
+  ab->type = TO_LE32(type);
+  update_block_sha1(ab);
+  return b;
 }
 
-void delete_separte_inode(struct inode *in, int val)
+// Case s d'un répertoire : les 900 cases directes de l'inode, puis des pages de 1000 cases
+// rangées dans le bloc double_indirect_block (type 7) et ses blocs d'adresses (type 6).
+// *blk reçoit le bloc qui contient la case ; NULL si la page n'existe pas (ou ne peut être créée)
+static int32_t *dir_slot(uint8_t *map, struct inode *dir, int64_t s, bool create, void **blk)
 {
-  for (int i = 0; i < 900; i++)
+  if (s < 900)
   {
-    if ((int)FROM_LE32(in->direct_blocks[i]) == val)
-    {
-      in->direct_blocks[i] = TO_LE32(-1);
-      break;
-    }
+    *blk = dir;
+    return &dir->direct_blocks[s];
   }
-  in->modification_time = TO_LE32(time(NULL));
-  calcul_sha1(in, 4000, in->sha1);
+  int32_t outer = (s - 900) / 1000, inner = (s - 900) % 1000;
+  if ((int32_t)FROM_LE32(dir->double_indirect_block) < 0)
+  {
+    int32_t b = create ? new_address_block(map, 7) : -1;
+    if (b < 0)
+      return NULL;
+    dir->double_indirect_block = TO_LE32(b);
+    update_block_sha1(dir);
+  }
+  struct address_block *dbl = get_address_block(map, FROM_LE32(dir->double_indirect_block));
+  if ((int32_t)FROM_LE32(dbl->addresses[outer]) < 0)
+  {
+    int32_t b = create ? new_address_block(map, 6) : -1;
+    if (b < 0)
+      return NULL;
+    dbl->addresses[outer] = TO_LE32(b);
+    update_block_sha1(dbl);
+  }
+  struct address_block *page = get_address_block(map, FROM_LE32(dbl->addresses[outer]));
+  *blk = page;
+  return &page->addresses[inner];
 }
 
-int32_t alloc_data_block(uint8_t *map)
+// Ancien conteneur sans champ parent (ouvert en lecture seule) : le répertoire qui contient
+// l'entrée est cherché parmi les inodes, 0 pour une entrée de premier niveau
+static int32_t legacy_parent(uint8_t *map, int32_t ino)
 {
+  if (FROM_LE32(get_inode(map, ino)->profondeur) == 0)
+    return 0;
   int32_t nb1, nbi, nba, nbb;
   get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
-  for (int32_t bloc_adresse_libre = 1 + nb1 + nbi; bloc_adresse_libre < nbb; bloc_adresse_libre++)
+  for (int32_t i = 0; i < nbi; i++)
+  {
+    struct inode *dir = get_inode(map, 1 + nb1 + i);
+    if (!(FROM_LE32(dir->flags) & 1) || !((FROM_LE32(dir->flags) >> 5) & 1))
+      continue;
+    struct dir_iter it;
+    dir_iter_init(&it, map, dir);
+    int32_t c;
+    while ((c = dir_iter_next(&it)) >= 0)
+      if (c == ino)
+        return 1 + nb1 + i;
+  }
+  return 0;
+}
+
+void inode_path(uint8_t *map, int32_t ino, char *buf, size_t len)
+{
+  // Remonte les parents jusqu'à la racine (ou jusqu'à un parent inconnu), puis écrit les noms depuis le haut
+  int32_t chain[256];
+  int n = 0;
+  int32_t root = get_root_inode(map);
+  bool parents = FROM_LE32(get_superblock(map)->features) & PFS_FEATURE_PARENT;
+  while (ino > 0 && ino != root && n < 256)
+  {
+    chain[n++] = ino;
+    ino = parents ? (int32_t)FROM_LE32(get_inode(map, ino)->parent) : legacy_parent(map, ino);
+  }
+  // Un seul "/" en tête, "/" seul pour la racine
+  size_t pos = 0;
+  if (n == 0)
+    snprintf(buf, len, "/");
+  for (int i = n - 1; i >= 0 && pos < len; i--)
+    pos += snprintf(buf + pos, len - pos, "/%s", get_inode(map, chain[i])->filename);
+}
+
+void dir_iter_init(struct dir_iter *it, uint8_t *map, struct inode *dir)
+{
+  it->map = map;
+  it->dir = dir;
+  it->pos = 0;
+  it->page = NULL;
+}
+
+int32_t dir_iter_next(struct dir_iter *it)
+{
+  while (it->pos < 900)
+  {
+    int32_t v = FROM_LE32(it->dir->direct_blocks[it->pos++]);
+    if (v >= 0)
+      return v;
+  }
+  int32_t dbl_blk = FROM_LE32(it->dir->double_indirect_block);
+  if (dbl_blk < 0)
+    return -1;
+  struct address_block *dbl = get_address_block(it->map, dbl_blk);
+  while (it->pos < DIR_MAX_ENTRIES)
   {
-    int32_t idx = bloc_adresse_libre / 32000;
-    int32_t bit = bloc_adresse_libre % 32000;
-    struct bitmap_block *bb = get_bitmap_block(map, idx + 1);
-    if ((bb->bits[bit / 8] & (1 << (bit % 8))) != 0)
+    int32_t outer = (it->pos - 900) / 1000, inner = (it->pos - 900) % 1000;
+    if (inner == 0 || it->page == NULL)
     {
-      bitmap_alloc(map, bloc_adresse_libre);
-      decremente_lbl(map);
-      return bloc_adresse_libre;
+      // Page suivante ; une page absente est sautée d'un coup
+      int32_t b = FROM_LE32(dbl->addresses[outer]);
+      if (b < 0)
+      {
+        it->page = NULL;
+        it->pos += 1000 - inner;
+        continue;
+      }
+      it->page = get_address_block(it->map, b);
     }
+    it->pos++;
+    int32_t v = FROM_LE32(it->page->addresses[inner]);
+    if (inner == 999)
+      it->page = NULL;
+    if (v >= 0)
+      return v;
   }
-  print_error("Erreur: pas de blocs de données libres disponibles");
   return -1;
 }
 
+void add_inode(uint8_t *map, struct inode *in, int val)
+{
+  // Première case libre à partir de l'indice du répertoire (pages absentes comprises)
+  void *blk;
+  int32_t *slot = NULL;
+  int64_t s = FROM_LE32(in->dir_free);
+  if (s < 0)
+    s = 0;
+  for (; s < DIR_MAX_ENTRIES; s++)
+  {
+    slot = dir_slot(map, in, s, false, &blk);
+    if (slot == NULL || (int32_t)FROM_LE32(*slot) < 0)
+      break;
+  }
+  if (s == DIR_MAX_ENTRIES)
+  {
+    fatal_error("Erreur: pas de place pour ajouter un inode");
+    return;
+  }
+  if (slot == NULL)
+    slot = dir_slot(map, in, s, true, &blk);
+  if (slot == NULL)
+  {
+    fatal_error("Erreur: pas de bloc libre pour agrandir le répertoire");
+    return;
+  }
+  *slot = TO_LE32(val);
+  if (blk != in)
+    update_block_sha1(blk);
+  in->dir_free = TO_LE32(s + 1);
+  // Le parent est le bloc de l'inode du répertoire (dans la projection)
+  struct inode *child = get_inode(map, val);
+  child->parent = TO_LE32((int32_t)(((uint8_t *)in - map) / 4096));
+  update_block_sha1(child);
+  dir_index_insert(map, in, val);
+  in->modification_time = TO_LE32(time(NULL));
+  update_block_sha1(in);
+}
+
+void dir_iter_remove(struct dir_iter *it)
+{
+  int64_t s = it->pos - 1;
+  void *blk;
+  int32_t *slot = dir_slot(it->map, it->dir, s, false, &blk);
+  if (slot == NULL || (int32_t)FROM_LE32(*slot) < 0)
+    return;
+  dir_index_remove(it->map, it->dir, FROM_LE32(*slot));
+  *slot = TO_LE32(-1);
+  if (blk != it->dir)
+    update_block_sha1(blk);
+  // La case libérée redevient la première candidate si elle est avant l'indice
+  if (s < (int64_t)FROM_LE32(it->dir->dir_free))
+    it->dir->dir_free = TO_LE32(s);
+  it->dir->modification_time = TO_LE32(time(NULL));
+  update_block_sha1(it->dir);
+}
+
+void delete_separte_inode(uint8_t *map, struct inode *in, int val)
+{
+  struct dir_iter it;
+  dir_iter_init(&it, map, in);
+  int32_t v;
+  while ((v = dir_iter_next(&it)) >= 0)
+  {
+    if (v == val)
+    {
+      dir_iter_remove(&it);
+      return;
+    }
+  }
+  // Enfant absent des cases : on le retire quand même de l'index
+  dir_index_remove(map, in, val);
+  in->modification_time = TO_LE32(time(NULL));
+  update_block_sha1(in);
+}
+
+// Rend un bloc de données ou d'adresses au bitmap
+void release_block(uint8_t *map, int32_t b)
+{
+  struct data_block *db = get_data_block(map, b);
+  db->type = TO_LE32(4);
+  update_block_sha1(db);
+  bitmap_dealloc(map, TO_LE32(b));
+  incremente_lbl(map);
+}
+
+// Libère les pages d'un répertoire (bloc double_indirect_block et ses blocs d'adresses), pas ses enfants
+static void dir_release_blocks(uint8_t *map, struct inode *in)
+{
+  int32_t dbl_blk = FROM_LE32(in->double_indirect_block);
+  if (dbl_blk < 0)
+    return;
+  struct address_block *dbl = get_address_block(map, dbl_blk);
+  for (int i = 0; i < 1000; i++)
+  {
+    int32_t b = FROM_LE32(dbl->addresses[i]);
+    if (b >= 0)
+      release_block(map, b);
+  }
+  release_block(map, dbl_blk);
+  in->double_indirect_block = TO_LE32(-1);
+  in->dir_free = TO_LE32(0);
+  update_block_sha1(in);
+}
+
+// Longueur de la série de blocs libres commençant à from, bornée par to (même bloc de bitmap k)
+static int32_t bitmap_run_length(const struct bitmap_block *bb, int32_t k, int32_t from, int32_t to)
+{
+  int32_t lo = from - k * 32000, hi = to - k * 32000, pos = lo;
+  while (pos < hi)
+  {
+    // Bits à 1 : blocs alloués, à partir de pos
+    uint64_t used = ~bitmap_word(bb, pos / 64) >> (pos % 64);
+    if (used)
+    {
+      pos += __builtin_ctzll(used);
+      break;
+    }
+    pos += 64 - pos % 64;
+  }
+  return (pos < hi ? pos : hi) - lo;
+}
+
+// Marque alloués len blocs libres consécutifs à partir de b (même bloc de bitmap)
+static void bitmap_alloc_run(uint8_t *map, int32_t b, int32_t len)
+{
+  int32_t k = b / 32000;
+  struct bitmap_block *bb = get_bitmap_block(map, k + 1);
+  int32_t lo = b - k * 32000, hi = lo + len;
+  for (int32_t w = lo / 64; w * 64 < hi; w++)
+  {
+    uint64_t word = bitmap_word(bb, w) & ~bitmap_word_mask(w, lo, hi);
+    word = htole64(word);
+    memcpy(bb->bits + w * 8, &word, 8);
+  }
+  if (map == session_map && bitmap_free && k < session_nb1 && bitmap_free[k] >= 0)
+    bitmap_free[k] -= len;
+  update_block_sha1(bb);
+}
+
+// Alloue jusqu'à n blocs de données par séries contiguës (next-fit), bitmap et superbloc mis à jour
+// une seule fois par série. Retourne le nombre de blocs alloués (moins de n si le conteneur est plein).
+int32_t alloc_data_blocks(uint8_t *map, int32_t n, int32_t out[])
+{
+  int32_t nb1, nbi, nba, nbb;
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  struct pignoufs *sb = get_superblock(map);
+  int32_t first = 1 + nb1 + nbi;
+  // Next-fit : on repart du curseur du superbloc, puis on reprend au début de la zone de données
+  int32_t start = FROM_LE32(sb->alloc_hint);
+  if (start < first || start >= nbb)
+    start = first;
+  int32_t pos = start, end = nbb, got = 0;
+  bool wrapped = false;
+  while (got < n)
+  {
+    int32_t b = bitmap_find_free(map, pos, end);
+    if (b < 0)
+    {
+      if (wrapped)
+        break;
+      wrapped = true;
+      pos = first;
+      end = start;
+      continue;
+    }
+    int32_t k = b / 32000;
+    int32_t limit = (k + 1) * 32000 < end ? (k + 1) * 32000 : end;
+    int32_t len = bitmap_run_length(get_bitmap_block(map, k + 1), k, b, limit);
+    if (len > n - got)
+      len = n - got;
+    bitmap_alloc_run(map, b, len);
+    for (int32_t i = 0; i < len; i++)
+      out[got++] = b + i;
+    pos = b + len;
+  }
+  if (got > 0)
+  {
+    sb->nb_l = TO_LE32(FROM_LE32(sb->nb_l) - got);
+    sb->alloc_hint = TO_LE32(pos);
+    update_block_sha1(sb);
+  }
+  return got;
+}
+
+int32_t alloc_data_block(uint8_t *map)
+{
+  // Les blocs réservés d'avance sont utilisés en premier (ils sont déjà marqués alloués)
+  if (map == session_map && reserved_head < reserved_count)
+    return reserved_blocks[reserved_head++];
+  int32_t bloc_adresse_libre;
+  if (alloc_data_blocks(map, 1, &bloc_adresse_libre) != 1)
+  {
+    print_error("Erreur: pas de blocs de données libres disponibles");
+    return -1;
+  }
+  return bloc_adresse_libre;
+}
+
+// Réserve n blocs de plus pour les prochains alloc_data_block de la session, retourne le nombre obtenu
+int32_t reserve_data_blocks(uint8_t *map, int32_t n)
+{
+  if (map != session_map || n <= 0)
+    return 0;
+  if (reserved_head == reserved_count)
+    reserved_head = reserved_count = 0;
+  if (reserved_count + n > reserved_capacity)
+  {
+    int32_t capacity = reserved_count + n;
+    int32_t *list = realloc(reserved_blocks, capacity * sizeof(int32_t));
+    if (!list)
+      return 0; // Pas de réservation : allocation bloc par bloc
+    reserved_blocks = list;
+    reserved_capacity = capacity;
+  }
+  int32_t got = alloc_data_blocks(map, n, reserved_blocks + reserved_count);
+  reserved_count += got;
+  return got;
+}
+
+// Blocs (données et adresses) occupés par un fichier de size octets
+static int64_t blocks_for_size(uint64_t size)
+{
+  int64_t data = (size + 3999) / 4000;
+  if (data <= 900)
+    return data;
+  if (data <= 1900)
+    return data + 1; // Simple indirect
+  if (data <= 900 + 1000 * 1000)
+    return data + 1 + (data - 900 + 999) / 1000; // Double indirect et ses blocs d'adresses
+  // Double indirection pleine, puis indirection triple : bloc de type 10, blocs de type 7 et pages
+  int64_t t = data - 900 - 1000 * 1000;
+  return data + 1 + 1000 + 1 + (t + 1000 * 1000 - 1) / (1000 * 1000) + (t + 999) / 1000;
+}
+
+// Réserve d'un coup les blocs nécessaires pour ajouter len octets à la fin du fichier in
+void reserve_for_append(uint8_t *map, struct inode *in, uint64_t len)
+{
+  uint64_t size = inode_size(in);
+  int64_t n = blocks_for_size(size + len) - blocks_for_size(size);
+  // Les blocs encore en réserve (réservation précédente de la session) sont utilisés en premier
+  if (map == session_map)
+    n -= reserved_count - reserved_head;
+  int32_t nb1, nbi, nba, nbb;
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  if (n > nba)
+    n = nba;
+  reserve_data_blocks(map, (int32_t)n);
+}
+
+// Réserve les blocs pour recopier à la fin de in le reste d'un fichier ouvert (fichiers réguliers seulement)
+void reserve_for_fd(uint8_t *map, struct inode *in, int fd)
+{
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+    return;
+  off_t pos = lseek(fd, 0, SEEK_CUR);
+  if (pos < 0)
+    pos = 0;
+  if (st.st_size > pos)
+    reserve_for_append(map, in, st.st_size - pos);
+}
+
+// Rend au bitmap les blocs réservés non utilisés ; le curseur revient au premier d'entre eux
+static void release_reserved_blocks(void)
+{
+  if (!session_map || reserved_head >= reserved_count)
+    return;
+  struct pignoufs *sb = (struct pignoufs *)session_map;
+  int32_t first = reserved_blocks[reserved_head];
+  for (int32_t i = reserved_head; i < reserved_count; i++)
+  {
+    bitmap_dealloc(session_map, TO_LE32(reserved_blocks[i]));
+    if (reserved_blocks[i] < first)
+      first = reserved_blocks[i];
+  }
+  sb->nb_l = TO_LE32(FROM_LE32(sb->nb_l) + reserved_count - reserved_head);
+  sb->alloc_hint = TO_LE32(first);
+  update_block_sha1(sb);
+  reserved_head = reserved_count = 0;
+}
+
 void bitmap_dealloc(uint8_t *map, int32_t blknum)
 {
   blknum = FROM_LE32(blknum);
   int32_t idx = blknum / 32000;
   int32_t bit = blknum % 32000;
   struct bitmap_block *bb = get_bitmap_block(map, idx + 1);
+  if (!(bb->bits[bit / 8] & (1 << (bit % 8))))
+    bitmap_count_adjust(map, blknum, 1);
   bb->bits[bit / 8] |= (1 << (bit % 8));
-  calcul_sha1(bb->bits, 4000, bb->sha1);
+  update_block_sha1(bb);
 }
 
-void dealloc_data_block(struct inode *in, uint8_t *map, int fd, size_t size)
+static struct extent *inode_extents(struct inode *in)
 {
-  int32_t nb1, nbi, nba, nbb;
-  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  return (struct extent *)in->direct_blocks;
+}
 
-    // Verrouiller l'inode
-  int inode_offset = (1 + nb1) * 4096 + (int64_t)(in - (struct inode *)map);
-  if (lock_block(fd, inode_offset, F_WRLCK) < 0)
+// Nombre d'extents d'un fichier décrit par extents
+static int extent_count(struct inode *in)
+{
+  struct extent *e = inode_extents(in);
+  int n = 0;
+  while (n < INODE_EXTENTS_MAX && (int32_t)FROM_LE32(e[n].length) > 0)
+    n++;
+  return n;
+}
+
+// Dernier des n extents commençant au plus tard au rang index (-1 s'il n'y en a pas), par dichotomie
+static int extent_find(struct inode *in, int n, int64_t index)
+{
+  struct extent *e = inode_extents(in);
+  int lo = 0, hi = n;
+  while (lo < hi)
   {
-    print_error("Erreur lors du verrouillage de l'inode");
-    close_fs(fd, map, size);
+    int mid = (lo + hi) / 2;
+    if ((int32_t)FROM_LE32(e[mid].logical) <= index)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+// Bloc physique du rang index d'un fichier décrit par extents, -1 pour un trou
+static int32_t extent_lookup(struct inode *in, int64_t index)
+{
+  struct extent *e = inode_extents(in);
+  int i = extent_find(in, extent_count(in), index);
+  if (i < 0)
+    return -1;
+  int64_t off = index - (int32_t)FROM_LE32(e[i].logical);
+  if (off >= (int32_t)FROM_LE32(e[i].length))
+    return -1;
+  return (int32_t)FROM_LE32(e[i].start) + (int32_t)off;
+}
+
+// Séries proches (écart d'au plus BLOCK_ITER_GAP blocs) regroupées en un seul madvise ;
+// les séries plus courtes sont laissées à la lecture anticipée du noyau
+#define BLOCK_ITER_GAP 16
+
+// Demande au noyau de charger les blocs listés dans addr[0..n), avant que le lecteur n'y arrive
+static void block_iter_advise(uint8_t *map, const int32_t *addr, int32_t n)
+{
+  int32_t lo = -1, hi = -1;
+  for (int32_t i = 0; i <= n; i++)
+  {
+    int32_t b = i < n ? (int32_t)FROM_LE32(addr[i]) : -1;
+    if (b < 0 && i < n)
+      continue;
+    if (lo >= 0 && (i == n || b < lo || b > hi + BLOCK_ITER_GAP))
+    {
+      if (hi - lo + 1 >= BLOCK_ITER_GAP)
+        madvise(map + (int64_t)lo * 4096, (size_t)(hi - lo + 1) * 4096, MADV_WILLNEED);
+      lo = -1;
+    }
+    if (i == n)
+      break;
+    if (lo < 0)
+      lo = hi = b;
+    else if (b > hi)
+      hi = b;
+  }
+}
+
+void block_iter_init(struct block_iter *it, uint8_t *map, struct inode *in)
+{
+  it->map = map;
+  it->in = in;
+  it->pos = 0;
+  it->run_pos = 0;
+  it->ind = NULL;
+  it->ind_type = 0;
+  it->tri = NULL;
+  it->mid = NULL;
+  it->mid_outer = -1;
+  it->page = NULL;
+  it->page_key = -1;
+  it->ext = 0;
+  if (FROM_LE32(in->flags) & INODE_EXTENTS)
     return;
+  block_iter_advise(map, in->direct_blocks, 900);
+  int32_t ind = FROM_LE32(in->double_indirect_block);
+  if (ind >= 0)
+  {
+    it->ind = get_address_block(map, ind);
+    it->ind_type = FROM_LE32(it->ind->type);
+    if (it->ind_type == 6)
+      block_iter_advise(map, it->ind->addresses, 1000);
   }
+  int32_t tri = FROM_LE32(in->triple_indirect_block);
+  if (tri > 0 && !inode_size32(in))
+    it->tri = get_address_block(map, tri);
+}
 
-  for (int i = 0; i < 900; i++)
+// Nombre de rangs logiques couverts par la structure du fichier
+static int64_t block_iter_end(const struct block_iter *it)
+{
+  if (it->tri != NULL)
+    return FILE_MAX_BLOCKS;
+  if (it->ind == NULL)
+    return 900;
+  return it->ind_type == 6 ? 900 + 1000 : 900 + 1000 * 1000;
+}
+
+// Case inner de la page outer du bloc d'adresses dbl (type 7), page chargée une fois (clé key)
+static int32_t block_iter_page(struct block_iter *it, struct address_block *dbl, int32_t outer, int64_t key,
+                               int32_t inner, int64_t *skip)
+{
+  if (key != it->page_key)
+  {
+    it->page_key = key;
+    int32_t pb = FROM_LE32(dbl->addresses[outer]);
+    it->page = pb < 0 ? NULL : get_address_block(it->map, pb);
+    if (it->page != NULL)
+      block_iter_advise(it->map, it->page->addresses, 1000);
+    // Le bloc d'adresses suivant est demandé dès maintenant
+    if (outer + 1 < 1000 && (pb = FROM_LE32(dbl->addresses[outer + 1])) >= 0)
+      madvise(it->map + (int64_t)pb * 4096, 4096, MADV_WILLNEED);
+  }
+  if (it->page == NULL)
+  {
+    *skip = 1000 - inner;
+    return -1;
+  }
+  return FROM_LE32(it->page->addresses[inner]);
+}
+
+// Bloc physique de rang logique pos, -1 pour un trou ; *skip reçoit le nombre de rangs à sauter
+// (plus d'un quand tout un bloc d'adresses manque)
+static int32_t block_iter_at(struct block_iter *it, int64_t pos, int64_t *skip)
+{
+  *skip = 1;
+  if (pos < 900)
+    return FROM_LE32(it->in->direct_blocks[pos]);
+  pos -= 900;
+  if (pos < 1000 * 1000)
+  {
+    if (it->ind == NULL || (it->ind_type == 6 && pos >= 1000))
+    {
+      *skip = 1000 * 1000 - pos;
+      return -1;
+    }
+    if (it->ind_type == 6)
+      return FROM_LE32(it->ind->addresses[pos]);
+    return block_iter_page(it, it->ind, pos / 1000, pos / 1000, pos % 1000, skip);
+  }
+  // Indirection triple : bloc de type 10, puis blocs de type 7 de 1000 pages chacun
+  pos -= 1000 * 1000;
+  if (it->tri == NULL)
+  {
+    *skip = FILE_MAX_BLOCKS - 900 - 1000 * 1000 - pos;
+    return -1;
+  }
+  int32_t m = pos / (1000 * 1000);
+  if (m != it->mid_outer)
+  {
+    it->mid_outer = m;
+    int32_t mb = FROM_LE32(it->tri->addresses[m]);
+    it->mid = mb < 0 ? NULL : get_address_block(it->map, mb);
+  }
+  if (it->mid == NULL)
+  {
+    *skip = 1000 * 1000 - pos % (1000 * 1000);
+    return -1;
+  }
+  return block_iter_page(it, it->mid, (pos / 1000) % 1000, 1000 + pos / 1000, pos % 1000, skip);
+}
+
+// Fichier décrit par extents : chaque extent est une série, sans lecture de blocs d'adresses
+static int32_t block_iter_next_extent(struct block_iter *it, int32_t *first)
+{
+  struct extent *e = inode_extents(it->in);
+  for (; it->ext < INODE_EXTENTS_MAX && (int32_t)FROM_LE32(e[it->ext].length) > 0; it->ext++)
+  {
+    int64_t lo = (int32_t)FROM_LE32(e[it->ext].logical);
+    int64_t end = lo + (int32_t)FROM_LE32(e[it->ext].length);
+    if (it->pos >= end)
+      continue;
+    if (it->pos < lo)
+      it->pos = lo;
+    *first = (int32_t)FROM_LE32(e[it->ext].start) + (int32_t)(it->pos - lo);
+    int32_t n = (int32_t)(end - it->pos);
+    it->run_pos = it->pos;
+    it->pos = end;
+    // Début de la série demandé au noyau, sa lecture anticipée prend le relais
+    if (n >= BLOCK_ITER_GAP)
+      madvise(it->map + (int64_t)*first * 4096, (size_t)(n < 1000 ? n : 1000) * 4096, MADV_WILLNEED);
+    return n;
+  }
+  return 0;
+}
+
+static int32_t block_iter_next_blocks(struct block_iter *it, int32_t *first)
+{
+  int32_t n = 0;
+  int64_t end = block_iter_end(it);
+  while (it->pos < end)
   {
-    int32_t b = FROM_LE32(in->direct_blocks[i]);
+    int64_t skip;
+    int32_t b = block_iter_at(it, it->pos, &skip);
     if (b < 0)
-      break;
-    if (lock_block(fd, b * 4096, F_WRLCK) < 0)
     {
-      print_error("Erreur lors du verrouillage d'un bloc de données");
-      unlock_block(fd, inode_offset);
-      close_fs(fd, map, size);
-      return;
+      if (n > 0)
+        break;
+      it->pos += skip; // Trou : bloc suivant, ou fin du bloc d'adresses absent
+      continue;
     }
-    struct data_block *db = get_data_block(map, in->direct_blocks[i]);
-    db->type = TO_LE32(4);
-    calcul_sha1(db->data, 4000, db->sha1);
-    bitmap_dealloc(map, in->direct_blocks[i]);
-    in->direct_blocks[i] = TO_LE32(-1);
-    incremente_lbl(map);
-    unlock_block(fd, b * 4096);
+    if (n == 0)
+    {
+      *first = b;
+      it->run_pos = it->pos;
+    }
+    else if (b != *first + n)
+      break;
+    n++;
+    it->pos++;
   }
-  if ((int32_t)FROM_LE32(in->double_indirect_block) >= 0)
+  return n;
+}
+
+int32_t block_iter_next_run(struct block_iter *it, int32_t *first)
+{
+  int32_t n = (FROM_LE32(it->in->flags) & INODE_EXTENTS) ? block_iter_next_extent(it, first)
+                                                         : block_iter_next_blocks(it, first);
+  // Résidence limitée : une série s'arrête au bout de sa fenêtre, comptée avant d'être rendue
+  if (n > 0 && resident_limit > 0 && it->map == session_map)
   {
-    struct address_block *dbl = get_address_block(map, FROM_LE32(in->double_indirect_block));
-    if ((int32_t)FROM_LE32(dbl->type) == 6)
+    int32_t room = RESIDENT_WINDOW_BLOCKS - *first % RESIDENT_WINDOW_BLOCKS;
+    if (n > room)
     {
-      for (int i = 0; i < 1000; i++)
-      {
-        int32_t db2 = FROM_LE32(dbl->addresses[i]);
-        if (db2 < 0)
-          break;
-        if (lock_block(fd, db2 * 4096, F_WRLCK) < 0)
-        {
-          print_error("Erreur lors du verrouillage d'un bloc de données indirect");
-          unlock_block(fd, inode_offset);
-          close_fs(fd, map, size);
-          return;
-        }
-        struct data_block *db = get_data_block(map, dbl->addresses[i]);
-        db->type = TO_LE32(4);
-        calcul_sha1(db->data, 4000, db->sha1);
-        bitmap_dealloc(map, dbl->addresses[i]);
-        dbl->addresses[i] = TO_LE32(-1);
-        incremente_lbl(map);
-        unlock_block(fd, db2 * 4096);
-      }
+      n = room;
+      it->pos = it->run_pos + n;
     }
-    else
+    resident_touch(it->map, *first);
+  }
+  return n;
+}
+
+// Rend un bloc d'adresses et les blocs d'adresses qu'il référence (pas les blocs de données)
+static void release_address_tree(uint8_t *map, int32_t b)
+{
+  struct address_block *ab = get_address_block(map, b);
+  int32_t type = FROM_LE32(ab->type);
+  if (type == 7 || type == 10)
+    for (int i = 0; i < 1000; i++)
     {
-      for (int i = 0; i < 1000; i++)
-      {
-        int32_t db2 = FROM_LE32(dbl->addresses[i]);
-        if (db2 < 0)
-          break;
-        struct address_block *sib = get_address_block(map, db2);
-        for (int j = 0; j < 1000; j++)
-        {
-          int32_t db3 = FROM_LE32(sib->addresses[j]);
-          if (db3 < 0)
-            break;
-
-          if (lock_block(fd, db3 * 4096, F_WRLCK) < 0)
-          {
-            print_error("Erreur lors du verrouillage d'un bloc de données double indirect");
-            unlock_block(fd, inode_offset);
-            close_fs(fd, map, size);
-            return;
-          }
-          struct data_block *db = get_data_block(map, db3);
-          db->type = TO_LE32(4);
-          calcul_sha1(db->data, 4000, db->sha1);
-          bitmap_dealloc(map, db3);
-          sib->addresses[j] = TO_LE32(-1);
-          incremente_lbl(map);
-          unlock_block(fd, db3 * 4096);
-        }
-        sib->type = TO_LE32(4);
-        calcul_sha1(sib->addresses, 4000, sib->sha1);
-        bitmap_dealloc(map, dbl->addresses[i]);
-        dbl->addresses[i] = TO_LE32(-1);
-        incremente_lbl(map);
-      }
+      int32_t c = FROM_LE32(ab->addresses[i]);
+      if (c >= 0)
+        release_address_tree(map, c);
     }
-    calcul_sha1(dbl->addresses, 4000, dbl->sha1);
-    dbl->type = TO_LE32(4);
-    bitmap_dealloc(map, in->double_indirect_block);
-    incremente_lbl(map);
+  release_block(map, b);
+}
+
+void dealloc_data_block(struct inode *in, uint8_t *map, int fd, size_t size)
+{
+  int32_t nb1, nbi, nba, nbb;
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+
+  // Verrouiller l'inode
+  int64_t inode_offset = block_offset_of(map, in);
+  if (lock_block(fd, inode_offset, F_WRLCK) < 0)
+  {
+    print_error("Erreur lors du verrouillage de l'inode");
+    close_fs(fd, map, size);
+    return;
   }
+
+  // Blocs de données (le verrou de l'inode couvre tout le fichier)
+  struct block_iter it;
+  block_iter_init(&it, map, in);
+  int32_t b, n;
+  while ((n = block_iter_next_run(&it, &b)) > 0)
+    for (int32_t k = 0; k < n; k++)
+      release_block(map, b + k);
+  // Puis les blocs d'adresses des niveaux d'indirection
+  int32_t ind = FROM_LE32(in->double_indirect_block);
+  if (ind >= 0)
+    release_address_tree(map, ind);
+  int32_t tri = FROM_LE32(in->triple_indirect_block);
+  if (tri > 0)
+    release_address_tree(map, tri);
+  memset(in->direct_blocks, 0xff, sizeof(in->direct_blocks));
   in->double_indirect_block = TO_LE32(-1);
-  in->file_size = TO_LE32(0);
+  in->triple_indirect_block = TO_LE32(0);
+  set_inode_size(in, 0);
   in->modification_time = TO_LE32(time(NULL));
-  calcul_sha1(in, 4000, in->sha1);
+  update_block_sha1(in);
 
   // Déverrouiller l'inode
   unlock_block(fd, inode_offset);
 }
 
+// Premier inode libre d'après le bitmap, à partir de l'indice du superbloc (-1 s'il n'y en a pas)
+int32_t alloc_inode(uint8_t *map)
+{
+  int32_t nb1, nbi, nba, nbb;
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  struct pignoufs *sb = get_superblock(map);
+  int32_t first = 1 + nb1, end = 1 + nb1 + nbi;
+  int32_t pos = FROM_LE32(sb->inode_hint);
+  if (pos < first || pos >= end)
+    pos = first;
+  while (pos < end)
+  {
+    int32_t k = pos / 32000;
+    int32_t limit = (k + 1) * 32000 < end ? (k + 1) * 32000 : end;
+    int32_t b = bitmap_scan(get_bitmap_block(map, k + 1), k, pos, limit);
+    if (b < 0)
+    {
+      pos = limit;
+      continue;
+    }
+    pos = b + 1;
+    // Bitmap en désaccord avec l'inode (ancien conteneur) : on corrige le bitmap et on continue
+    if (FROM_LE32(get_inode(map, b)->flags) & 1)
+    {
+      bitmap_alloc(map, b);
+      continue;
+    }
+    sb->inode_hint = TO_LE32(b + 1);
+    update_block_sha1(sb);
+    return b;
+  }
+  sb->inode_hint = TO_LE32(end);
+  update_block_sha1(sb);
+  return -1;
+}
+
 void delete_inode(struct inode *in, uint8_t *map, int pos, int fd, size_t size)
 {
-  dealloc_data_block(in, map, fd, size);
+  dir_index_free(map, in);
+  // Les cases d'un répertoire sont des numéros d'inodes : seules ses pages sont libérées
+  if ((FROM_LE32(in->flags) >> 5) & 1)
+    dir_release_blocks(map, in);
+  else
+    dealloc_data_block(in, map, fd, size);
   in->flags = TO_LE32(0);
-  in->file_size = TO_LE32(0);
+  set_inode_size(in, 0);
   in->creation_time = TO_LE32(0);
   in->access_time = TO_LE32(0);
   in->modification_time = TO_LE32(0);
   memset(in->filename, 0, sizeof(in->filename));
   memset(in->extensions, 0, sizeof in->extensions);
   bitmap_dealloc(map, pos);
+  // L'inode libéré redevient le premier candidat s'il est avant l'indice
+  struct pignoufs *sb = get_superblock(map);
+  if (pos < (int32_t)FROM_LE32(sb->inode_hint))
+    sb->inode_hint = TO_LE32(pos);
   decrement_nb_f(map);
-  calcul_sha1(in, 4000, in->sha1);
+  update_block_sha1(in);
 }
 
 // Crée un fichier et retourne l'index de l'inode nouvellement créé
@@ -446,18 +1732,7 @@ int create_file(uint8_t *map, const char *filename)
 {
   int32_t nb1, nbi, nba, nbb;
   get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
-  int32_t free_idx = -1;
-
-  // Scan inodes
-  for (int i = 0; i < nbi; i++)
-  {
-    struct inode *in = get_inode(map, 1 + nb1 + i);
-    if (!(FROM_LE32(in->flags) & 1))
-    {
-      free_idx = i;
-      break;
-    }
-  }
+  int32_t free_idx = alloc_inode(map) - (1 + nb1);
   if (free_idx < 0)
   {
     fatal_error("create_file: aucun inode libre disponible");
@@ -467,7 +1742,7 @@ int create_file(uint8_t *map, const char *filename)
   struct inode *in = get_inode(map, inode_blk);
   init_inode(in, filename, false);
   bitmap_alloc(map, inode_blk);
-  calcul_sha1(in, 4000, in->sha1);
+  update_block_sha1(in);
   in->profondeur = TO_LE32(0); // Racine
   // Mettre à jour les compteurs du superbloc et son SHA1
   increment_nb_f(map);
@@ -479,17 +1754,7 @@ int create_directory_main(uint8_t *map, const char *dirname, int profondeur)
 {
   int32_t nb1, nbi, nba, nbb;
   get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
-  int32_t free_idx = -1;
-  // Scan inodes
-  for (int i = 0; i < nbi; i++)
-  {
-    struct inode *in = get_inode(map, 1 + nb1 + i);
-    if (!(FROM_LE32(in->flags) & 1))
-    {
-      free_idx = i;
-      break;
-    }
-  }
+  int32_t free_idx = alloc_inode(map) - (1 + nb1);
   if (free_idx < 0)
   {
     fatal_error("mkdir: aucun inode libre disponible");
@@ -500,7 +1765,7 @@ int create_directory_main(uint8_t *map, const char *dirname, int profondeur)
   init_inode(in, dirname, true);        // true = répertoire
   in->profondeur = TO_LE32(profondeur); // Racine
   bitmap_alloc(map, inode_blk);
-  calcul_sha1(in, 4000, in->sha1);
+  update_block_sha1(in);
   increment_nb_f(map);
   return inode_blk; // Renvoie l'index de l'inode
 }
@@ -524,33 +1789,24 @@ int create_directory(uint8_t *map, char *dirname)
     {
       val = find_inode_racine(map, nb1, nbi, token, true);
       if (val == -1)
+      {
         val = create_directory_main(map, token, cpt);
+        add_root_entry(map, val);
+      }
       parent = get_inode(map, val);
     }
     else
     {
-      val = -1;
-      for (int i = 0; i < 900; i++)
-      {
-        // Vérifie que le bloc est valide
-        if (parent->direct_blocks[i] >= 0)
-        {
-          in = get_inode(map, FROM_LE32(parent->direct_blocks[i]));
-          // Vérifie que le nom correspond et que c'est bien un dossier
-          if (strcmp(in->filename, token) == 0 && (FROM_LE32(in->flags >> 5) & 1))
-          {
-            val = FROM_LE32(parent->direct_blocks[i]);
-            parent = in;
-            break;
-          }
-        }
-      }
-      if (val == -1)
+      // Recherche du sous-dossier (indexée si le dossier a un index)
+      val = find_file_folder_from_inode(map, parent, token, true);
+      if (val >= 0)
+        parent = get_inode(map, val);
+      else
       {
         // Crée le dossier si non trouvé
         val = create_directory_main(map, token, cpt);
         in = get_inode(map, val);
-        add_inode(parent, val);
+        add_inode(map, parent, val);
         parent = in;
       }
     }
@@ -561,121 +1817,360 @@ int create_directory(uint8_t *map, char *dirname)
   return val; // Renvoie l'index de l'inode
 }
 
-// Récupère le dernier bloc de données écrit pour un fichier
-int32_t get_last_data_block(uint8_t *map, struct inode *in)
+// Nouveau bloc de données d'un fichier, rempli de zéros
+static int32_t new_file_block(uint8_t *map)
+{
+  int32_t b = alloc_data_block(map);
+  if (b < 0)
+    return -1;
+  struct data_block *db = get_data_block(map, b);
+  memset(db->data, 0, sizeof(db->data));
+  db->type = TO_LE32(5);
+  update_block_sha1(db);
+  return b;
+}
+
+// Case c d'un bloc d'adresses, créant au besoin le bloc d'adresses de type type qu'elle doit référencer
+static struct address_block *address_child(uint8_t *map, struct address_block *ab, int32_t c, int32_t type, bool create)
 {
-  uint32_t size = FROM_LE32(in->file_size);
-  int32_t last_index = (size - 1) / 4000;
-  if ((int32_t)FROM_LE32(in->double_indirect_block) == -1)
+  int32_t b = FROM_LE32(ab->addresses[c]);
+  if (b < 0)
   {
-    return (int32_t)FROM_LE32(in->direct_blocks[last_index]);
+    if (!create || (b = new_address_block(map, type)) < 0)
+      return NULL;
+    ab->addresses[c] = TO_LE32(b);
+    update_block_sha1(ab);
   }
-  else
+  return get_address_block(map, b);
+}
+
+// Case du rang t de l'indirection triple : bloc de type 10, puis type 7, puis page de type 6
+static int32_t *triple_slot(uint8_t *map, struct inode *in, int64_t t, bool create, void **blk)
+{
+  int32_t tri = inode_size32(in) ? 0 : FROM_LE32(in->triple_indirect_block);
+  if (tri <= 0)
   {
-    last_index -= 900;
-    struct address_block *dbl = get_address_block(map, FROM_LE32(in->double_indirect_block));
-    if (FROM_LE32(dbl->type) == 6)
-    {
-      return FROM_LE32(dbl->addresses[last_index]);
-    }
-    else
-    {
-      int outer = last_index / 1000;
-      int inner = last_index % 1000;
-      struct address_block *sib = get_address_block(map, FROM_LE32(dbl->addresses[outer]));
-      return FROM_LE32(sib->addresses[inner]);
-    }
+    if (!create || (tri = new_address_block(map, 10)) < 0)
+      return NULL;
+    in->triple_indirect_block = TO_LE32(tri);
+    update_block_sha1(in);
   }
+  struct address_block *mid = address_child(map, get_address_block(map, tri), t / (1000 * 1000), 7, create);
+  if (mid == NULL)
+    return NULL;
+  struct address_block *page = address_child(map, mid, (t / 1000) % 1000, 6, create);
+  if (page == NULL)
+    return NULL;
+  *blk = page;
+  return &page->addresses[t % 1000];
 }
 
-// Récupère le prochain bloc de données libre pour un fichier (ou l'alloue)
-int32_t get_last_data_block_null(uint8_t *map, struct inode *in)
+// Case de l'adresse du bloc de rang index d'un fichier : l'inode (900 cases directes), le bloc simple
+// indirect (type 6, 1000 cases) ou une page de la double indirection (type 7 puis type 6).
+// *blk reçoit le bloc qui contient la case ; NULL si le niveau d'adresses manque (ou ne peut être créé)
+static int32_t *file_slot(uint8_t *map, struct inode *in, int64_t index, bool create, void **blk)
 {
-  uint32_t size = FROM_LE32(in->file_size);
-  int32_t last_index = size / 4000;
-  if (last_index == 900 + (1000 * 1000))
+  if (index < 0 || index >= FILE_MAX_BLOCKS)
+    return NULL;
+  if (index < 900)
   {
-    perror("Erreur: limite de 1000900 blocs de données atteinte");
-    return -2;
+    *blk = in;
+    return &in->direct_blocks[index];
+  }
+  index -= 900;
+  if (index >= 1000 * 1000)
+    return triple_slot(map, in, index - 1000 * 1000, create, blk);
+  int32_t ind = FROM_LE32(in->double_indirect_block);
+  if (ind < 0)
+  {
+    if (!create || (ind = new_address_block(map, index < 1000 ? 6 : 7)) < 0)
+      return NULL;
+    in->double_indirect_block = TO_LE32(ind);
+    update_block_sha1(in);
   }
-  if (in->double_indirect_block == -1)
+  struct address_block *dbl = get_address_block(map, ind);
+  if (FROM_LE32(dbl->type) == 6 && index >= 1000)
   {
-    if (last_index >= 900)
+    // Passage à la double indirection : le bloc simple indirect devient la première page
+    int32_t d;
+    if (!create || (d = new_address_block(map, 7)) < 0)
+      return NULL;
+    dbl = get_address_block(map, d);
+    dbl->addresses[0] = TO_LE32(ind);
+    update_block_sha1(dbl);
+    in->double_indirect_block = TO_LE32(d);
+    update_block_sha1(in);
+  }
+  if (FROM_LE32(dbl->type) == 7)
+  {
+    int32_t outer = index / 1000;
+    int32_t pb = FROM_LE32(dbl->addresses[outer]);
+    if (pb < 0)
     {
-      int32_t dbl_blk = alloc_data_block(map);
-      in->double_indirect_block = TO_LE32(dbl_blk);
-      struct address_block *dbl = get_address_block(map, dbl_blk);
-      memset(dbl->addresses, -1, sizeof(dbl->addresses));
-      calcul_sha1(dbl->addresses, 4000, dbl->sha1);
-      calcul_sha1(in, 4000, in->sha1);
-      dbl->type = TO_LE32(6);
-      goto rec1;
+      if (!create || (pb = new_address_block(map, 6)) < 0)
+        return NULL;
+      dbl->addresses[outer] = TO_LE32(pb);
+      update_block_sha1(dbl);
     }
-    int32_t dbl_blk = alloc_data_block(map);
-    in->direct_blocks[last_index] = TO_LE32(dbl_blk);
-    calcul_sha1(in, 4000, in->sha1);
-    return dbl_blk;
+    dbl = get_address_block(map, pb);
+    index %= 1000;
+  }
+  *blk = dbl;
+  return &dbl->addresses[index];
+}
+
+// Ajoute le bloc physique b au rang index (un trou) d'un fichier décrit par extents, en prolongeant
+// un extent voisin quand b le continue ; faux s'il faudrait un extent de plus et qu'il n'y a plus de place
+static bool extent_insert(struct inode *in, int64_t index, int32_t b)
+{
+  struct extent *e = inode_extents(in);
+  int n = extent_count(in);
+  int i = extent_find(in, n, index);
+  bool left = i >= 0 && (int32_t)FROM_LE32(e[i].logical) + (int32_t)FROM_LE32(e[i].length) == index &&
+              (int32_t)FROM_LE32(e[i].start) + (int32_t)FROM_LE32(e[i].length) == b;
+  bool right = i + 1 < n && (int32_t)FROM_LE32(e[i + 1].logical) == index + 1 &&
+               (int32_t)FROM_LE32(e[i + 1].start) == b + 1;
+  if (left && right)
+  {
+    // Le bloc relie deux extents : ils n'en font plus qu'un
+    e[i].length = TO_LE32(FROM_LE32(e[i].length) + 1 + FROM_LE32(e[i + 1].length));
+    memmove(&e[i + 1], &e[i + 2], (n - i - 2) * sizeof(struct extent));
+    memset(&e[n - 1], 0xff, sizeof(struct extent));
+  }
+  else if (left)
+    e[i].length = TO_LE32(FROM_LE32(e[i].length) + 1);
+  else if (right)
+  {
+    e[i + 1].logical = TO_LE32((int32_t)index);
+    e[i + 1].start = TO_LE32(b);
+    e[i + 1].length = TO_LE32(FROM_LE32(e[i + 1].length) + 1);
+  }
+  else
+  {
+    if (n == INODE_EXTENTS_MAX)
+      return false;
+    memmove(&e[i + 2], &e[i + 1], (n - i - 1) * sizeof(struct extent));
+    e[i + 1].logical = TO_LE32((int32_t)index);
+    e[i + 1].start = TO_LE32(b);
+    e[i + 1].length = TO_LE32(1);
+  }
+  update_block_sha1(in);
+  return true;
+}
+
+// Retire le rang index d'un fichier décrit par extents et renvoie son bloc physique : -1 pour un trou,
+// -2 s'il faudrait couper un extent en deux et qu'il n'y a plus de place
+static int32_t extent_remove(struct inode *in, int64_t index)
+{
+  struct extent *e = inode_extents(in);
+  int n = extent_count(in);
+  int i = extent_find(in, n, index);
+  if (i < 0)
+    return -1;
+  int32_t len = FROM_LE32(e[i].length);
+  int32_t start = FROM_LE32(e[i].start);
+  int32_t off = (int32_t)(index - (int32_t)FROM_LE32(e[i].logical));
+  if (off >= len)
+    return -1;
+  if (len == 1)
+  {
+    memmove(&e[i], &e[i + 1], (n - i - 1) * sizeof(struct extent));
+    memset(&e[n - 1], 0xff, sizeof(struct extent));
   }
+  else if (off == 0)
+  {
+    e[i].logical = TO_LE32((int32_t)index + 1);
+    e[i].start = TO_LE32(start + 1);
+    e[i].length = TO_LE32(len - 1);
+  }
+  else if (off == len - 1)
+    e[i].length = TO_LE32(len - 1);
   else
   {
-  rec1:
-    last_index -= 900;
-    struct address_block *dbl = get_address_block(map, FROM_LE32(in->double_indirect_block));
-    if (FROM_LE32(dbl->type) == 6)
+    if (n == INODE_EXTENTS_MAX)
+      return -2;
+    memmove(&e[i + 2], &e[i + 1], (n - i - 1) * sizeof(struct extent));
+    e[i].length = TO_LE32(off);
+    e[i + 1].logical = TO_LE32((int32_t)index + 1);
+    e[i + 1].start = TO_LE32(start + off + 1);
+    e[i + 1].length = TO_LE32(len - off - 1);
+  }
+  update_block_sha1(in);
+  return start + off;
+}
+
+int file_use_blocks(uint8_t *map, struct inode *in)
+{
+  if (!(FROM_LE32(in->flags) & INODE_EXTENTS))
+    return 0;
+  struct extent ext[INODE_EXTENTS_MAX];
+  int n = extent_count(in);
+  memcpy(ext, inode_extents(in), n * sizeof(struct extent));
+  // Place pour les blocs d'adresses (au plus ceux d'un fichier plein), vérifiée avant de toucher à l'inode
+  int64_t end = n > 0 ? (int64_t)(int32_t)FROM_LE32(ext[n - 1].logical) + (int32_t)FROM_LE32(ext[n - 1].length) : 0;
+  int64_t avail = FROM_LE32(get_superblock(map)->nb_l);
+  if (map == session_map)
+    avail += reserved_count - reserved_head;
+  if (blocks_for_size((uint64_t)end * 4000) - end > avail)
+  {
+    print_error("Erreur: pas assez de blocs libres pour passer le fichier à l'adressage par blocs");
+    return -1;
+  }
+  memset(in->direct_blocks, 0xff, sizeof(in->direct_blocks));
+  in->flags = TO_LE32(FROM_LE32(in->flags) & ~INODE_EXTENTS);
+  update_block_sha1(in);
+  for (int i = 0; i < n; i++)
+  {
+    int32_t logical = FROM_LE32(ext[i].logical), start = FROM_LE32(ext[i].start);
+    for (int32_t k = 0; k < (int32_t)FROM_LE32(ext[i].length); k++)
     {
-      if (last_index >= 1000)
-      {
-        int32_t save = in->double_indirect_block; // Pas besoin de conversion, on garde juste la valeur telle quelle
-        int32_t dbl_blk = alloc_data_block(map);
-        in->double_indirect_block = TO_LE32(dbl_blk);
-        struct address_block *dbl2 = get_address_block(map, dbl_blk);
-        memset(dbl2->addresses, -1, sizeof(dbl2->addresses));
-        dbl2->type = TO_LE32(7);
-        dbl2->addresses[0] = save;
-        calcul_sha1(dbl2->addresses, 4000, dbl2->sha1);
-        calcul_sha1(in, 4000, in->sha1);
-        dbl = dbl2;
-        goto rec2;
-      }
-      if ((int32_t)FROM_LE32(dbl->addresses[last_index]) == -1)
-      {
-        int32_t dbl_blk = alloc_data_block(map);
-        dbl->addresses[last_index] = TO_LE32(dbl_blk);
-        calcul_sha1(dbl->addresses, 4000, dbl->sha1);
-      }
-      return FROM_LE32(dbl->addresses[last_index]);
+      void *blk;
+      int32_t *slot = file_slot(map, in, (int64_t)logical + k, true, &blk);
+      if (slot == NULL)
+        fatal_error("file_use_blocks: plus de blocs libres pour les adresses");
+      *slot = TO_LE32(start + k);
+      update_block_sha1(blk);
     }
-    else
+  }
+  return 0;
+}
+
+int32_t file_block_at(uint8_t *map, struct inode *in, int64_t index, bool create)
+{
+  int32_t b = -1;
+  if (FROM_LE32(in->flags) & INODE_EXTENTS)
+  {
+    b = extent_lookup(in, index);
+    if (b >= 0 || !create || index < 0 || index >= FILE_MAX_BLOCKS || (b = new_file_block(map)) < 0)
+      return b;
+    if (extent_insert(in, index, b))
+      return b;
+    // Plus de place pour un extent : le fichier passe à l'adressage par blocs, b y est rangé
+    if (file_use_blocks(map, in) < 0)
     {
-    rec2:
-      int outer = last_index / 1000;
-      int inner = last_index % 1000;
-      if ((int32_t)FROM_LE32(dbl->addresses[outer]) == -1)
-      {
-        int32_t dbl_blk = alloc_data_block(map);
-        dbl->addresses[outer] = TO_LE32(dbl_blk);
-        struct address_block *dbl2 = get_address_block(map, dbl_blk);
-        memset(dbl2->addresses, -1, sizeof(dbl2->addresses));
-        calcul_sha1(dbl2->addresses, 4000, dbl2->sha1);
-        calcul_sha1(dbl, 4000, dbl->sha1);
-        dbl2->type = TO_LE32(6);
-      }
+      release_block(map, b);
+      return -1;
+    }
+  }
+  void *blk;
+  int32_t *slot = file_slot(map, in, index, create, &blk);
+  if (slot == NULL)
+  {
+    if (b >= 0)
+      release_block(map, b);
+    return -1;
+  }
+  if ((int32_t)FROM_LE32(*slot) >= 0)
+    return FROM_LE32(*slot);
+  if (create && (b >= 0 || (b = new_file_block(map)) >= 0))
+  {
+    *slot = TO_LE32(b);
+    update_block_sha1(blk);
+  }
+  return b;
+}
+
+void file_block_punch(uint8_t *map, struct inode *in, int64_t index)
+{
+  if (FROM_LE32(in->flags) & INODE_EXTENTS)
+  {
+    int32_t b = extent_remove(in, index);
+    if (b >= 0)
+      release_block(map, b);
+    // Extent à couper sans place pour le second morceau : on passe à l'adressage par blocs
+    if (b != -2 || file_use_blocks(map, in) < 0)
+      return;
+  }
+  void *blk;
+  int32_t *slot = file_slot(map, in, index, false, &blk);
+  if (slot == NULL || (int32_t)FROM_LE32(*slot) < 0)
+    return;
+  release_block(map, FROM_LE32(*slot));
+  *slot = TO_LE32(-1);
+  update_block_sha1(blk);
+}
 
-      struct address_block *sib = get_address_block(map, FROM_LE32(dbl->addresses[outer]));
-      if ((int32_t)FROM_LE32(sib->addresses[inner]) == -1)
+// Vrai si aucune des 1000 cases d'un bloc d'adresses n'est utilisée
+static bool address_block_empty(const struct address_block *ab)
+{
+  for (int i = 0; i < 1000; i++)
+    if ((int32_t)FROM_LE32(ab->addresses[i]) >= 0)
+      return false;
+  return true;
+}
+
+// Rend les blocs d'adresses vides sous b (types 7 et 10), puis b s'il est vide ; vrai si b a été rendu
+static bool prune_address_block(uint8_t *map, int32_t b)
+{
+  struct address_block *ab = get_address_block(map, b);
+  int32_t type = FROM_LE32(ab->type);
+  if (type == 7 || type == 10)
+  {
+    bool changed = false;
+    for (int i = 0; i < 1000; i++)
+    {
+      int32_t c = FROM_LE32(ab->addresses[i]);
+      if (c >= 0 && prune_address_block(map, c))
       {
-        int32_t dbl_blk = alloc_data_block(map);
-        sib->addresses[inner] = TO_LE32(dbl_blk);
-        calcul_sha1(sib->addresses, 4000, sib->sha1);
+        ab->addresses[i] = TO_LE32(-1);
+        changed = true;
       }
-      return FROM_LE32(sib->addresses[inner]);
     }
+    if (changed)
+      update_block_sha1(ab);
   }
+  if (!address_block_empty(ab))
+    return false;
+  release_block(map, b);
+  return true;
+}
+
+void file_release_empty_pages(uint8_t *map, struct inode *in)
+{
+  int32_t ind = FROM_LE32(in->double_indirect_block);
+  if (ind >= 0 && prune_address_block(map, ind))
+  {
+    in->double_indirect_block = TO_LE32(-1);
+    update_block_sha1(in);
+  }
+  int32_t tri = FROM_LE32(in->triple_indirect_block);
+  if (tri > 0 && prune_address_block(map, tri))
+  {
+    in->triple_indirect_block = TO_LE32(0);
+    update_block_sha1(in);
+  }
+}
+
+// Récupère le dernier bloc de données écrit pour un fichier (alloué s'il tombe dans un trou)
+int32_t get_last_data_block(uint8_t *map, struct inode *in)
+{
+  return file_block_at(map, in, (int64_t)((inode_size(in) - 1) / 4000), true);
+}
+
+// Récupère le prochain bloc de données libre pour un fichier (ou l'alloue)
+int32_t get_last_data_block_null(uint8_t *map, struct inode *in)
+{
+  int64_t last_index = inode_size(in) / 4000;
+  if (last_index >= FILE_MAX_BLOCKS)
+  {
+    print_error("Erreur: nombre maximal de blocs de données d'un fichier atteint");
+    return -2;
+  }
+  int32_t b = file_block_at(map, in, last_index, true);
+  return b < 0 ? -2 : b; // Plus de blocs libres
+}
+
+// Position d'un bloc projeté dans le conteneur (décalage à passer à lock_block)
+int64_t block_offset_of(const uint8_t *map, const void *blk)
+{
+  return (const uint8_t *)blk - map;
 }
 
-// Verrouille un bloc pour lecture ou écriture
+// Verrouille un bloc pour lecture ou écriture : table partagée de la session, fcntl à défaut
 int lock_block(int fd, int64_t block_offset, int lock_type)
 {
+  if (lock_table_covers(fd))
+    return lock_table_lock(fd, block_offset / 4096, lock_type == F_WRLCK) ? 0 : -1;
   struct flock fl = {0};
   fl.l_type = lock_type; // F_RDLCK pour lecture, F_WRLCK pour écriture
   fl.l_whence = SEEK_SET;
@@ -687,6 +2182,11 @@ int lock_block(int fd, int64_t block_offset, int lock_type)
 // Déverrouille un bloc
 int unlock_block(int fd, int64_t block_offset)
 {
+  // Les SHA1 des blocs modifiés sous le verrou sont écrits avant de le rendre : celui qui le prend
+  // ensuite lit des données et des SHA1 cohérents
+  commit_dirty_blocks();
+  if (lock_table_covers(fd))
+    return lock_table_unlock(fd, block_offset / 4096) ? 0 : -1;
   struct flock fl = {0};
   fl.l_type = F_UNLCK;
   fl.l_whence = SEEK_SET;
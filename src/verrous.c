@@ -0,0 +1,438 @@
+#define _GNU_SOURCE // F_OFD_SETLK
+#include "../include/verrous.h"
+#include <stdatomic.h>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+
+// Chaque processus qui utilise la table y occupe un emplacement (LOCK_SLOTS au plus, un bit par lecteur
+// dans un mot de futex), tenu par un verrou sur l'octet 1 + emplacement du segment : il est rendu par
+// le noyau si le processus meurt. Table pleine : le processus passe par fcntl, et les suivants aussi.
+// Mot de verrou d'un bloc : LOCK_WRITER et emplacement de l'écrivain, ou un bit par emplacement lecteur.
+// LOCK_WAITERS est posé par un processus qui s'endort sur le mot : celui qui rend le verrou le réveille
+#define LOCK_WRITER (1u << 31)
+#define LOCK_WAITERS (1u << 30)
+#define LOCK_VALUE (LOCK_WAITERS - 1)
+#define LOCK_SLOTS 30
+// Attente maximale avant de vérifier que les détenteurs sont toujours vivants (100 ms)
+#define LOCK_WAIT_NS 100000000
+
+// En-tête du segment, suivi d'un mot par bloc
+struct lock_slot
+{
+  _Atomic uint32_t in_use;    // Emplacement occupé (resté à 1 si son processus est mort)
+  uint32_t unused;
+  _Atomic int64_t upgrading; // Bloc + 1 dont le verrou de lecture attend de passer en écriture
+};
+struct lock_header
+{
+  struct lock_slot slots[LOCK_SLOTS];
+};
+
+static struct lock_header *header = NULL;
+static _Atomic uint32_t *table = NULL;
+static int64_t table_blocks = 0;
+static size_t table_size = 0;
+static int table_fd = -1;     // Segment de mémoire partagée
+static int container_fd = -1; // Conteneur couvert par la table
+static char table_name[64];
+static int slot = -1;         // Emplacement du processus
+static uint32_t self_bit = 0; // Bit de lecteur de l'emplacement
+static uint32_t self = 0;     // LOCK_WRITER | emplacement
+// Octet du conteneur (au-delà de sa fin) verrouillé en lecture par les processus qui, faute de table,
+// utilisent fcntl : la table et fcntl ne servent jamais ensemble sur un même conteneur
+#define FCNTL_MODE_BYTE ((off_t)1 << 62)
+static int fcntl_mode_fd = -1;
+// Verrous tenus par le processus : un bloc déjà tenu n'est pas repris deux fois (comme avec fcntl),
+// et ceux qui restent sont rendus à la fermeture de la table
+struct held_lock
+{
+  int64_t block;
+  bool write;
+};
+static struct held_lock *held = NULL;
+static int32_t held_count = 0;
+static int32_t held_capacity = 0;
+
+static long futex(_Atomic uint32_t *addr, int op, uint32_t val, const struct timespec *timeout)
+{
+  return syscall(SYS_futex, (uint32_t *)addr, op, val, timeout, NULL, 0);
+}
+
+// Verrou sur un octet, lié à l'ouverture du fichier. Dans le segment, l'octet 0 est partagé tant que
+// la table sert, l'octet 1 + s est tenu par le processus de l'emplacement s
+static int byte_lock(int fd, off_t byte, int type, int cmd)
+{
+  struct flock fl = {0};
+  fl.l_type = type;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = byte;
+  fl.l_len = 1;
+  return fcntl(fd, cmd, &fl);
+}
+
+// Retire l'emplacement s (lecteur ou écrivain) du mot, et réveille ceux qui attendent
+static void slot_release_word(_Atomic uint32_t *w, int s)
+{
+  uint32_t v = atomic_load_explicit(w, memory_order_relaxed);
+  uint32_t nv;
+  do
+  {
+    if (v & LOCK_WRITER)
+    {
+      if ((v & LOCK_VALUE) != (uint32_t)s)
+        return;
+      nv = 0;
+    }
+    else
+    {
+      if (!(v & (1u << s)))
+        return;
+      nv = v & ~(1u << s) & ~LOCK_WAITERS;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(w, &v, nv, memory_order_release, memory_order_relaxed));
+  if (v & LOCK_WAITERS)
+    futex(w, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+// Prend un emplacement libre, -1 si les LOCK_SLOTS sont occupés (le processus passe alors par fcntl).
+// Celui d'un processus mort est d'abord débarrassé des verrous qu'il tenait encore
+static int slot_claim(int fd)
+{
+  int s = -1;
+  for (int i = 0; i < LOCK_SLOTS && s < 0; i++)
+    if (byte_lock(fd, 1 + i, F_WRLCK, F_OFD_SETLK) == 0)
+      s = i;
+  if (s < 0)
+    return -1;
+  if (atomic_load(&header->slots[s].in_use))
+    for (int64_t b = 0; b < table_blocks; b++)
+      slot_release_word(&table[b], s);
+  atomic_store(&header->slots[s].upgrading, 0);
+  atomic_store(&header->slots[s].in_use, 1);
+  return s;
+}
+
+// Processus fils : la table et les verrous tenus restent ceux du parent (comme avec fcntl)
+static void lock_table_forget(void)
+{
+  fcntl_mode_fd = -1;
+  if (table_fd < 0)
+    return;
+  if (header != NULL)
+    munmap(header, table_size);
+  close(table_fd); // Les verrous du segment appartiennent à l'ouverture, toujours tenue par le parent
+  free(held);
+  held = NULL;
+  held_count = held_capacity = 0;
+  header = NULL;
+  table = NULL;
+  table_blocks = 0;
+  table_size = 0;
+  table_fd = container_fd = -1;
+  slot = -1;
+}
+
+// Le segment doit avoir le propriétaire et les droits du conteneur : seuls ceux qui peuvent écrire
+// le conteneur peuvent écrire ses verrous
+static bool table_matches(int sfd, const struct stat *cst)
+{
+  struct stat st;
+  return fstat(sfd, &st) == 0 && st.st_uid == cst->st_uid && st.st_gid == cst->st_gid &&
+         (st.st_mode & 0777) == (cst->st_mode & 0666);
+}
+
+// Ouvre (ou crée) la table nommée table_name et y prend un emplacement. Échoue si le segment n'a pas
+// le propriétaire et les droits du conteneur, si on ne peut pas l'ouvrir en écriture ou s'il est plein
+static bool table_attach(int fd, const struct stat *cst, int64_t nbb)
+{
+  struct stat st;
+  int sfd;
+  for (;;)
+  {
+    sfd = shm_open(table_name, O_RDWR, 0);
+    if (sfd < 0 && errno == ENOENT)
+    {
+      sfd = shm_open(table_name, O_RDWR | O_CREAT | O_EXCL, cst->st_mode & 0666);
+      if (sfd < 0 && errno == EEXIST)
+        continue;
+      // Droits du conteneur malgré le umask, et son propriétaire s'il n'est pas le nôtre
+      if (sfd >= 0 && (fchmod(sfd, cst->st_mode & 0666) < 0 ||
+                      ((cst->st_uid != geteuid() || cst->st_gid != getegid()) &&
+                       fchown(sfd, cst->st_uid, cst->st_gid) < 0)))
+      {
+        close(sfd);
+        shm_unlink(table_name);
+        return false;
+      }
+    }
+    if (sfd < 0)
+      return false;
+    if (!table_matches(sfd, cst))
+    {
+      close(sfd);
+      return false;
+    }
+    // Seul utilisateur : les verrous laissés par des processus disparus sont effacés
+    if (byte_lock(sfd, 0, F_WRLCK, F_OFD_SETLK) == 0)
+    {
+      if (ftruncate(sfd, 0) < 0 || byte_lock(sfd, 0, F_RDLCK, F_OFD_SETLK) < 0)
+      {
+        close(sfd);
+        return false;
+      }
+    }
+    else if (byte_lock(sfd, 0, F_RDLCK, F_OFD_SETLKW) < 0)
+    {
+      close(sfd);
+      return false;
+    }
+    // Le dernier utilisateur a pu supprimer le segment entre shm_open et le verrou : on recommence
+    struct stat a, b;
+    int check = shm_open(table_name, O_RDWR, 0);
+    bool same = check >= 0 && fstat(sfd, &a) == 0 && fstat(check, &b) == 0 && a.st_ino == b.st_ino;
+    if (check >= 0)
+      close(check);
+    if (same)
+      break;
+    close(sfd);
+  }
+  size_t size = sizeof(struct lock_header) + (size_t)nbb * sizeof(uint32_t);
+  if (fstat(sfd, &st) < 0 || ((size_t)st.st_size < size && ftruncate(sfd, size) < 0))
+  {
+    close(sfd);
+    return false;
+  }
+  void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, sfd, 0);
+  if (p == MAP_FAILED)
+  {
+    close(sfd);
+    return false;
+  }
+  header = p;
+  table = (_Atomic uint32_t *)(header + 1);
+  table_blocks = nbb;
+  table_size = size;
+  slot = slot_claim(sfd);
+  if (slot < 0)
+  {
+    munmap(p, size);
+    header = NULL;
+    table = NULL;
+    table_blocks = 0;
+    table_size = 0;
+    close(sfd);
+    return false;
+  }
+  table_fd = sfd;
+  container_fd = fd;
+  self_bit = 1u << slot;
+  self = LOCK_WRITER | (uint32_t)slot;
+  return true;
+}
+
+// Vrai si un autre processus utilise la table du conteneur (ou si on ne peut pas le savoir). Un segment
+// qui n'a pas le propriétaire et les droits du conteneur ne sert à personne
+static bool table_in_use(const struct stat *cst)
+{
+  int sfd = shm_open(table_name, O_RDONLY, 0);
+  if (sfd < 0)
+    return errno != ENOENT;
+  if (!table_matches(sfd, cst))
+  {
+    close(sfd);
+    return false;
+  }
+  struct flock fl = {0};
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = 0;
+  fl.l_len = 1;
+  bool used = fcntl(sfd, F_OFD_GETLK, &fl) < 0 || fl.l_type != F_UNLCK;
+  close(sfd);
+  return used;
+}
+
+// Vrai si un autre processus verrouille ce conteneur avec fcntl
+static bool fcntl_mode_in_use(int fd)
+{
+  struct flock fl = {0};
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = FCNTL_MODE_BYTE;
+  fl.l_len = 1;
+  return fcntl(fd, F_OFD_GETLK, &fl) < 0 || fl.l_type != F_UNLCK;
+}
+
+bool lock_table_open(int fd, int64_t nbb)
+{
+  static bool atfork_registered = false;
+  if (!atfork_registered)
+  {
+    pthread_atfork(NULL, NULL, lock_table_forget);
+    atfork_registered = true;
+  }
+  lock_table_close();
+  struct stat st;
+  if (nbb <= 0 || fstat(fd, &st) < 0)
+    return false;
+  snprintf(table_name, sizeof(table_name), "/pignoufs-%llx-%llx", (unsigned long long)st.st_dev,
+           (unsigned long long)st.st_ino);
+  // Chacun s'annonce (table ouverte, ou octet de fcntl) puis regarde si l'autre mécanisme sert :
+  // deux processus qui s'annoncent en même temps se voient au moins l'un l'autre
+  if (table_attach(fd, &st, nbb))
+  {
+    if (!fcntl_mode_in_use(fd))
+      return true;
+    lock_table_close();
+  }
+  if (byte_lock(fd, FCNTL_MODE_BYTE, F_RDLCK, F_OFD_SETLK) < 0)
+    return false;
+  // Ceux qui ouvrent le conteneur passent maintenant par fcntl : on attend que la table ne serve plus
+  struct timespec pause = {0, 10000000};
+  while (table_in_use(&st))
+    nanosleep(&pause, NULL);
+  fcntl_mode_fd = fd;
+  return true;
+}
+
+bool lock_table_covers(int fd)
+{
+  return table != NULL && fd == container_fd;
+}
+
+void lock_table_close(void)
+{
+  if (fcntl_mode_fd >= 0)
+    byte_lock(fcntl_mode_fd, FCNTL_MODE_BYTE, F_UNLCK, F_OFD_SETLK);
+  fcntl_mode_fd = -1;
+  if (table_fd < 0)
+    return;
+  // Verrous oubliés (sortie sur erreur) : rendus comme le ferait la fermeture du fichier avec fcntl
+  while (held_count > 0)
+    lock_table_unlock(container_fd, held[held_count - 1].block);
+  // L'emplacement est rendu propre : le suivant n'aura rien à nettoyer
+  atomic_store(&header->slots[slot].in_use, 0);
+  // Dernier utilisateur : le segment est supprimé (les autres revérifient le nom à l'ouverture)
+  if (byte_lock(table_fd, 0, F_WRLCK, F_OFD_SETLK) == 0)
+    shm_unlink(table_name);
+  lock_table_forget();
+}
+
+static int32_t held_find(int64_t b)
+{
+  for (int32_t i = held_count - 1; i >= 0; i--)
+    if (held[i].block == b)
+      return i;
+  return -1;
+}
+
+// Attend un changement du mot (valeur lue v) ; après le délai, les détenteurs disparus (écrivain
+// ou lecteurs) sont délogés. L'emplacement d'un mort est pris le temps de le retirer du mot,
+// ce qui l'empêche d'être réattribué entre-temps
+static void lock_wait(_Atomic uint32_t *w, uint32_t v)
+{
+  if (!(v & LOCK_WAITERS) && !atomic_compare_exchange_weak(w, &v, v | LOCK_WAITERS))
+    return; // Le mot a changé : nouvel essai
+  v |= LOCK_WAITERS;
+  struct timespec ts = {0, LOCK_WAIT_NS};
+  if (futex(w, FUTEX_WAIT, v, &ts) == 0 || errno != ETIMEDOUT)
+    return;
+  uint32_t holders = (v & LOCK_WRITER) ? 1u << (v & LOCK_VALUE) : v & LOCK_VALUE;
+  holders &= ~self_bit;
+  for (int s = 0; s < LOCK_SLOTS; s++)
+    if ((holders & (1u << s)) && byte_lock(table_fd, 1 + s, F_WRLCK, F_OFD_SETLK) == 0)
+    {
+      atomic_store(&header->slots[s].upgrading, 0);
+      slot_release_word(w, s);
+      byte_lock(table_fd, 1 + s, F_UNLCK, F_OFD_SETLK);
+    }
+}
+
+// Passe en écriture le verrou de lecture held[i] quand les autres lecteurs sont partis. Si un
+// autre lecteur attend aussi de passer en écriture, refus (EDEADLK) comme avec fcntl
+static bool lock_upgrade(int32_t i)
+{
+  int64_t b = held[i].block;
+  _Atomic uint32_t *w = &table[b];
+  atomic_store(&header->slots[slot].upgrading, b + 1);
+  for (;;)
+  {
+    uint32_t v = atomic_load_explicit(w, memory_order_relaxed);
+    uint32_t others = v & LOCK_VALUE & ~self_bit;
+    if (others == 0)
+    {
+      if (atomic_compare_exchange_weak_explicit(w, &v, self | (v & LOCK_WAITERS), memory_order_acquire,
+                                                memory_order_relaxed))
+        break;
+      continue;
+    }
+    for (int s = 0; s < LOCK_SLOTS; s++)
+      if ((others & (1u << s)) && atomic_load(&header->slots[s].upgrading) == b + 1)
+      {
+        atomic_store(&header->slots[slot].upgrading, 0);
+        errno = EDEADLK;
+        return false;
+      }
+    lock_wait(w, v);
+  }
+  atomic_store(&header->slots[slot].upgrading, 0);
+  held[i].write = true;
+  return true;
+}
+
+bool lock_table_lock(int fd, int64_t b, bool write)
+{
+  if (table == NULL || fd != container_fd || b < 0 || b >= table_blocks)
+  {
+    errno = EINVAL;
+    return false;
+  }
+  // Bloc déjà tenu : un verrou d'écriture couvre la lecture, une lecture passe en écriture
+  int32_t i = held_find(b);
+  if (i >= 0)
+    return write && !held[i].write ? lock_upgrade(i) : true;
+  if (held_count == held_capacity)
+  {
+    int32_t capacity = held_capacity ? 2 * held_capacity : 16;
+    struct held_lock *list = realloc(held, capacity * sizeof(struct held_lock));
+    if (!list)
+    {
+      errno = ENOMEM;
+      return false;
+    }
+    held = list;
+    held_capacity = capacity;
+  }
+  _Atomic uint32_t *w = &table[b];
+  for (;;)
+  {
+    uint32_t v = atomic_load_explicit(w, memory_order_relaxed);
+    bool available = write ? (v & ~LOCK_WAITERS) == 0 : !(v & LOCK_WRITER);
+    if (!available)
+    {
+      lock_wait(w, v);
+      continue;
+    }
+    uint32_t nv = write ? self | (v & LOCK_WAITERS) : v | self_bit;
+    if (atomic_compare_exchange_weak_explicit(w, &v, nv, memory_order_acquire, memory_order_relaxed))
+      break;
+  }
+  held[held_count].block = b;
+  held[held_count++].write = write;
+  return true;
+}
+
+bool lock_table_unlock(int fd, int64_t b)
+{
+  if (table == NULL || fd != container_fd || b < 0 || b >= table_blocks)
+    return false;
+  int32_t i = held_find(b);
+  if (i < 0)
+    return true; // Rien à rendre
+  held[i] = held[--held_count];
+  slot_release_word(&table[b], slot);
+  return true;
+}
@@ -1,11 +1,18 @@
 // Déclarations de fonctions de test
+#define _GNU_SOURCE // F_OFD_SETLK
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
 #include <stdbool.h>
+#include <sys/wait.h>
+#include <errno.h>
 #include "../include/commands.h"
 #include "../include/structures.h"
+#include "../include/sha1.h"
+#include "../include/lecture_ecriture.h"
+#include "../include/index_dossier.h"
+#include "../include/verrous.h"
 
 void write_external_file(const char *filename, const char *content)
 {
@@ -14,6 +21,24 @@ void write_external_file(const char *filename, const char *content)
   close(fd);
 }
 
+// Redirige la sortie standard vers un fichier ; retourne l'ancienne sortie à passer à end_capture
+int start_capture(const char *filename)
+{
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  dup2(fd, STDOUT_FILENO);
+  close(fd);
+  return saved;
+}
+
+void end_capture(int saved)
+{
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+}
+
 int read_file_content(const char *filename, char *buf, size_t buflen)
 {
   int fd = open(filename, O_RDONLY);
@@ -64,6 +89,11 @@ void TEST_MKFS()
     {
       printf("[OK] Magic string correcte\n");
     }
+    // L'inode racine est le premier bloc d'inodes (superbloc + 1 bloc de bitmap)
+    if (r == sizeof(sb) && (FROM_LE32(sb.features) & PFS_FEATURE_ROOT) && FROM_LE32(sb.root_inode) == 2)
+      printf("[OK] Inode racine créé par mkfs\n");
+    else
+      printf("[FAIL] Inode racine absent du superbloc\n");
     close(fd_mkfs);
   }
 
@@ -437,6 +467,55 @@ void TEST_INPUT()
   unlink(tmp_input);
 }
 
+void TEST_INPUT_TUBE()
+{
+  printf("=== Test cmd_input depuis un tube ===\n");
+  const char *fsname = "test_input_tube_fs";
+  unlink(fsname);
+  int ok = cmd_mkfs(fsname, 10, 20) == 0;
+  // Morceaux de 2500 octets : les lectures courtes laissent le dernier bloc entamé
+  static char content[25000];
+  for (size_t k = 0; k < sizeof(content); k++)
+    content[k] = 'a' + k % 23;
+  int p[2];
+  ok = ok && pipe(p) == 0;
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    close(p[0]);
+    for (size_t k = 0; k < sizeof(content); k += 2500)
+    {
+      write(p[1], content + k, 2500);
+      usleep(5000);
+    }
+    _exit(0);
+  }
+  close(p[1]);
+  int saved_stdin = dup(STDIN_FILENO);
+  dup2(p[0], STDIN_FILENO);
+  ok = ok && cmd_input(fsname, "tube") == 0;
+  dup2(saved_stdin, STDIN_FILENO);
+  close(saved_stdin);
+  close(p[0]);
+  int status;
+  waitpid(pid, &status, 0);
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  static char buf[25000];
+  int fd = open_fs_ro(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int32_t ino = find_inode_racine(map, nb1, nbi, "tube", false);
+  ok = ok && ino >= 0 && inode_size(get_inode(map, ino)) == sizeof(content) &&
+       pfs_pread(map, get_inode(map, ino), buf, sizeof(buf), 0) == sizeof(buf) && memcmp(buf, content, sizeof(buf)) == 0;
+  close_fs(fd, map, size);
+  if (ok && cmd_fsck(fsname) == 0)
+    printf("[OK] cmd_input depuis un tube, par lectures courtes\n");
+  else
+    printf("[FAIL] cmd_input depuis un tube\n");
+  unlink(fsname);
+}
+
 void TEST_ADDINPUT()
 {
   printf("=== Test cmd_addinput ===\n");
@@ -953,6 +1032,887 @@ void TEST_MV_DIR()
   unlink(fsname);
 }
 
+void TEST_FSCK()
+{
+  printf("=== Test cmd_fsck ===\n");
+  const char *fsname_fsck = "test_fsck";
+  unlink(fsname_fsck);
+  if (cmd_mkfs(fsname_fsck, 5, 20) != 0)
+  {
+    printf("[FAIL] mkfs pour fsck\n");
+    return;
+  }
+
+  if (cmd_fsck(fsname_fsck) != 0)
+    printf("[FAIL] cmd_fsck sur un conteneur sain\n");
+  else
+    printf("[OK] cmd_fsck sur un conteneur sain retourne 0\n");
+
+  // Corrompt le contenu d'un bloc de données (bloc 10) sans recalculer son SHA1
+  int fd = open(fsname_fsck, O_RDWR);
+  pwrite(fd, "X", 1, 10 * 4096 + 100);
+  close(fd);
+  if (cmd_fsck(fsname_fsck) == 0)
+    printf("[FAIL] cmd_fsck ne détecte pas un SHA1 incorrect\n");
+  else
+    printf("[OK] cmd_fsck détecte un SHA1 incorrect\n");
+
+  // Type de bloc invalide dans la zone de données
+  int32_t bad_type = TO_LE32(42);
+  fd = open(fsname_fsck, O_RDWR);
+  pwrite(fd, &bad_type, 4, 12 * 4096 + 4020);
+  close(fd);
+  if (cmd_fsck(fsname_fsck) == 0)
+    printf("[FAIL] cmd_fsck ne détecte pas un type incorrect\n");
+  else
+    printf("[OK] cmd_fsck détecte un type incorrect\n");
+
+  unlink(fsname_fsck);
+}
+
+void TEST_SHA1()
+{
+  printf("=== Test des noyaux SHA1 ===\n");
+  static const char *noms[] = {"OpenSSL", "SSE2", "AVX2", "SHA-NI"};
+  static const size_t longueurs[] = {0, 3, 55, 56, 64, 119, 4000};
+  enum { NB = 11 };
+  static uint8_t buf[NB][4000];
+  uint8_t ref[NB][20], res[NB][20];
+  const void *data[NB];
+  uint8_t *out_ref[NB], *out_res[NB];
+  for (int i = 0; i < NB; i++)
+  {
+    for (int j = 0; j < 4000; j++)
+      buf[i][j] = (uint8_t)(i * 31 + j * 7 + (j >> 8));
+    data[i] = buf[i];
+    out_ref[i] = ref[i];
+    out_res[i] = res[i];
+  }
+
+  for (int k = SHA1_KERNEL_SSE2; k <= SHA1_KERNEL_SHANI; k++)
+  {
+    if (!sha1_kernel_supported(k))
+    {
+      printf("[OK] noyau %s non supporté par ce CPU\n", noms[k]);
+      continue;
+    }
+    bool ok = true;
+    for (size_t l = 0; l < sizeof(longueurs) / sizeof(longueurs[0]); l++)
+      for (int n = 1; n <= NB; n++)
+      {
+        set_sha1_kernel(SHA1_KERNEL_OPENSSL);
+        calcul_sha1_many(data, n, longueurs[l], out_ref);
+        set_sha1_kernel(k);
+        calcul_sha1_many(data, n, longueurs[l], out_res);
+        if (memcmp(ref, res, n * 20) != 0)
+          ok = false;
+      }
+    if (ok)
+      printf("[OK] noyau %s identique à OpenSSL\n", noms[k]);
+    else
+      printf("[FAIL] noyau %s différent d'OpenSSL\n", noms[k]);
+  }
+  set_sha1_kernel(sha1_best_kernel());
+}
+
+void TEST_DIR_INDEX()
+{
+  printf("=== Test index des répertoires ===\n");
+  const char *fsname = "test_dir_index_fs";
+  char path[64];
+  unlink(fsname);
+  if (cmd_mkfs(fsname, 100, 100) != 0)
+  {
+    printf("[FAIL] mkfs pour l'index des répertoires\n");
+    return;
+  }
+  cmd_mkdir(fsname, "d");
+  // Assez d'entrées pour que l'index soit créé puis agrandi
+  int ok = 1;
+  for (int i = 0; i < 40 && ok; i++)
+  {
+    snprintf(path, sizeof(path), "d/s%d", i);
+    ok = cmd_mkdir(fsname, path) == 0;
+  }
+  // Les recherches passent par l'index : création dans chaque sous-dossier
+  for (int i = 0; i < 40 && ok; i++)
+  {
+    snprintf(path, sizeof(path), "d/s%d/x", i);
+    ok = cmd_mkdir(fsname, path) == 0;
+  }
+  if (!ok)
+    printf("[FAIL] création dans un répertoire indexé (%s)\n", path);
+  else if (cmd_fsck(fsname) != 0)
+    printf("[FAIL] cmd_fsck sur un répertoire indexé\n");
+  else
+    printf("[OK] répertoire indexé cohérent\n");
+  unlink(fsname);
+}
+
+void TEST_GRAND_DOSSIER()
+{
+  printf("=== Test répertoire de plus de 900 entrées ===\n");
+  const char *fsname = "test_grand_dossier_fs";
+  char path[64];
+  unlink(fsname);
+  if (cmd_mkfs(fsname, 1000, 50) != 0)
+  {
+    printf("[FAIL] mkfs pour le grand répertoire\n");
+    return;
+  }
+  // Au-delà de 900 enfants, les entrées passent dans des pages de cases
+  int ok = 1;
+  for (int i = 0; i < 950 && ok; i++)
+  {
+    snprintf(path, sizeof(path), "g/s%d", i);
+    ok = cmd_mkdir(fsname, path) == 0;
+  }
+  if (ok)
+    ok = cmd_mkdir(fsname, "g/s940/x") == 0 && cmd_fsck(fsname) == 0;
+  if (!ok)
+    printf("[FAIL] répertoire de 950 entrées\n");
+  else if (cmd_rmdir(fsname, "g/") != 0 || cmd_fsck(fsname) != 0)
+    printf("[FAIL] suppression du répertoire de 950 entrées\n");
+  else
+    printf("[OK] répertoire de 950 entrées créé puis supprimé\n");
+  unlink(fsname);
+}
+
+void TEST_INDEX_RECONSTRUIT()
+{
+  printf("=== Test de reconstruction de l'index d'un répertoire ===\n");
+  const char *fsname = "test_index_fs";
+  char path[64];
+  unlink(fsname);
+  int ok = cmd_mkfs(fsname, 1200, 100) == 0;
+  for (int i = 0; ok && i < 1100; i++)
+  {
+    snprintf(path, sizeof(path), "g/s%d", i);
+    ok = cmd_mkdir(fsname, path) == 0;
+  }
+  // Index abandonné (comme faute de place) : le prochain ajout le reconstruit pour tous les enfants
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int32_t g = find_inode_racine(map, nb1, nbi, "g", true);
+  ok = ok && g >= 0;
+  if (ok)
+    dir_index_free(map, get_inode(map, g));
+  close_fs(fd, map, size);
+  ok = ok && cmd_mkdir(fsname, "g/nouveau") == 0;
+  // Chaque enfant est toujours trouvé par l'index
+  fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  struct inode *dir = ok ? get_inode(map, g) : NULL;
+  ok = ok && FROM_LE32(dir->dir_index) > 0;
+  for (int i = 0; ok && i < 1100; i++)
+  {
+    snprintf(path, sizeof(path), "s%d", i);
+    ok = find_file_folder_from_inode(map, dir, path, true) >= 0;
+  }
+  close_fs(fd, map, size);
+  if (ok && cmd_fsck(fsname) == 0)
+    printf("[OK] index reconstruit avec les 1101 enfants\n");
+  else
+    printf("[FAIL] reconstruction de l'index d'un répertoire\n");
+  unlink(fsname);
+}
+
+void TEST_CACHE_DEPLACEMENT()
+{
+  printf("=== Test du cache des chemins après un déplacement ===\n");
+  const char *fsname = "test_cache_mv_fs";
+  unlink(fsname);
+  int ok = cmd_mkfs(fsname, 10, 100) == 0 && cmd_mkdir(fsname, "a") == 0 && cmd_mkdir(fsname, "b") == 0 &&
+           cmd_mkdir(fsname, "a/d") == 0 && cmd_mkdir(fsname, "a/d/e") == 0;
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  // Chemins résolus (et mis en cache), puis d déplacé sous b avec le même nom dans la même session
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int32_t a = find_inode_folder(map, nb1, nbi, "a");
+  int32_t b = find_inode_folder(map, nb1, nbi, "b");
+  int32_t d = find_inode_folder(map, nb1, nbi, "a/d");
+  int32_t e = find_inode_folder(map, nb1, nbi, "a/d/e");
+  ok = ok && a > 0 && b > 0 && d > 0 && e > 0;
+  if (ok)
+  {
+    delete_separte_inode(map, get_inode(map, a), d);
+    add_inode(map, get_inode(map, b), d);
+    ok = find_inode_folder(map, nb1, nbi, "a/d") == -1 && find_inode_folder(map, nb1, nbi, "a/d/e") == -1 &&
+         find_inode_folder(map, nb1, nbi, "b/d") == d && find_inode_folder(map, nb1, nbi, "b/d/e") == e;
+  }
+  close_fs(fd, map, size);
+  // Même chose par mv : l'ancien chemin n'est plus résolu
+  ok = ok && cmd_mv(fsname, "b/d/", "a/d/") == 0;
+  fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  ok = ok && find_inode_folder(map, nb1, nbi, "a/d") == d && find_inode_folder(map, nb1, nbi, "b/d") == -1;
+  close_fs(fd, map, size);
+  ok = ok && cmd_mv(fsname, "a/d/", "b/d/") == 0;
+  fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  ok = ok && find_inode_folder(map, nb1, nbi, "a/d") == -1 && find_inode_folder(map, nb1, nbi, "b/d") == d;
+  close_fs(fd, map, size);
+  if (ok)
+    printf("[OK] répertoire déplacé introuvable sous son ancien chemin\n");
+  else
+    printf("[FAIL] cache des chemins après un déplacement\n");
+  unlink(fsname);
+}
+
+void TEST_GRAND_FICHIER()
+{
+  printf("=== Test fichier au-delà des blocs directs ===\n");
+  const char *fsname = "test_grand_fichier_fs";
+  const char *file_ext = "gros_ext";
+  const char *file_copy = "gros_copie";
+  unlink(fsname);
+  if (cmd_mkfs(fsname, 10, 2000) != 0)
+  {
+    printf("[FAIL] mkfs pour le grand fichier\n");
+    return;
+  }
+  // 5 Mo (plus de 900 blocs), le motif n'est que dans le dernier bloc
+  size_t len = 5000000;
+  char *content = malloc(len + 1);
+  memset(content, 'x', len);
+  memcpy(content + len - 9, "aiguille\n", 9);
+  content[len] = '\0';
+  write_external_file(file_ext, content);
+  char *copy = malloc(len + 1);
+  if (cmd_add(fsname, file_ext, "gros") != 0)
+    printf("[FAIL] cmd_add du grand fichier\n");
+  else if (cmd_cp(fsname, "gros", file_copy, true, false) != 0 ||
+           read_file_content(file_copy, copy, len + 1) != (int)len || memcmp(copy, content, len) != 0)
+    printf("[FAIL] copie externe du grand fichier\n");
+  else
+  {
+    // grep doit lire le fichier jusqu'au bout
+    char out[64];
+    int saved = start_capture("gros_grep");
+    int r = cmd_grep(fsname, "aiguille");
+    end_capture(saved);
+    if (r != 0 || read_file_content("gros_grep", out, sizeof(out)) < 0 || strcmp(out, "/gros\n") != 0)
+      printf("[FAIL] grep du motif en fin de grand fichier\n");
+    else if (cmd_punch(fsname, "gros", 10, 100) != 0 || cmd_punch(fsname, "gros", 12000, 800000) != 0)
+      printf("[FAIL] trous dans le grand fichier\n");
+    else
+    {
+      // cat doit rendre les mêmes octets, avec des zéros dans les trous
+      memset(content + 10, 0, 100);
+      memset(content + 12000, 0, 800000);
+      saved = start_capture("gros_cat");
+      r = cmd_cat(fsname, "gros");
+      end_capture(saved);
+      if (r != 0 || read_file_content("gros_cat", copy, len + 1) != (int)len || memcmp(copy, content, len) != 0)
+        printf("[FAIL] cat du grand fichier creux\n");
+      else if (cmd_rm(fsname, "gros") != 0 || cmd_fsck(fsname) != 0)
+        printf("[FAIL] suppression du grand fichier\n");
+      else
+        printf("[OK] grand fichier copié, lu avec ses trous puis supprimé\n");
+    }
+  }
+  free(copy);
+  free(content);
+  unlink(fsname);
+  unlink(file_ext);
+  unlink(file_copy);
+  unlink("gros_grep");
+  unlink("gros_cat");
+}
+
+void TEST_READ_WRITE()
+{
+  printf("=== Test pfs_pread / pfs_pwrite ===\n");
+  const char *fsname = "test_rw_fs";
+  unlink(fsname);
+  write_external_file("rw_ext", "0123456789");
+  if (cmd_mkfs(fsname, 10, 100) != 0 || cmd_add(fsname, "rw_ext", "rw") != 0)
+  {
+    printf("[FAIL] mkfs/add pour pread/pwrite\n");
+    unlink(fsname);
+    unlink("rw_ext");
+    return;
+  }
+  uint8_t *map;
+  size_t size;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  int32_t nb1, nbi, nba, nbb;
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  struct inode *in = get_inode(map, find_inode_racine(map, nb1, nbi, "rw", false));
+  // Réécriture au milieu, puis écriture au-delà de la fin à cheval sur deux blocs
+  char buf[16] = {0};
+  int ok = pfs_pwrite(map, in, "ab", 2, 4) == 2 && pfs_pwrite(map, in, "xyz", 3, 3999) == 3;
+  ok = ok && inode_size(in) == 4002;
+  ok = ok && pfs_pread(map, in, buf, 6, 2) == 6 && memcmp(buf, "23ab67", 6) == 0;
+  ok = ok && pfs_pread(map, in, buf, 16, 3996) == 6 && memcmp(buf, "\0\0\0xyz", 6) == 0;
+  ok = ok && pfs_pread(map, in, buf, 4, 5000) == 0;
+  close_fs(fd, map, size);
+  if (ok && cmd_fsck(fsname) == 0)
+    printf("[OK] lecture et écriture à une position\n");
+  else
+    printf("[FAIL] lecture et écriture à une position\n");
+  unlink(fsname);
+  unlink("rw_ext");
+}
+
+void TEST_FICHIER_CREUX()
+{
+  printf("=== Test fichier creux et punch ===\n");
+  const char *fsname = "test_creux_fs";
+  unlink(fsname);
+  write_external_file("creux_ext", "0123456789");
+  if (cmd_mkfs(fsname, 10, 100) != 0 || cmd_add(fsname, "creux_ext", "creux") != 0)
+  {
+    printf("[FAIL] mkfs/add pour le fichier creux\n");
+    unlink(fsname);
+    unlink("creux_ext");
+    return;
+  }
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int32_t libres = FROM_LE32(get_superblock(map)->nb_l);
+  struct inode *in = get_inode(map, find_inode_racine(map, nb1, nbi, "creux", false));
+  // Écriture loin après la fin : un seul bloc de plus, l'écart se lit comme des zéros
+  char buf[8];
+  int ok = pfs_pwrite(map, in, "fin", 3, 200000) == 3;
+  ok = ok && pfs_pread(map, in, buf, 4, 100000) == 4 && memcmp(buf, "\0\0\0\0", 4) == 0;
+  close_fs(fd, map, size);
+  fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  in = get_inode(map, find_inode_racine(map, nb1, nbi, "creux", false));
+  ok = ok && (int32_t)FROM_LE32(get_superblock(map)->nb_l) == libres - 1;
+  // Le premier bloc est rendu, la taille ne change pas
+  ok = ok && pfs_punch(map, in, 0, 4000) == 0 && inode_size(in) == 200003;
+  ok = ok && pfs_pread(map, in, buf, 3, 0) == 3 && memcmp(buf, "\0\0\0", 3) == 0;
+  ok = ok && pfs_pread(map, in, buf, 3, 200000) == 3 && memcmp(buf, "fin", 3) == 0;
+  close_fs(fd, map, size);
+  fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  ok = ok && (int32_t)FROM_LE32(get_superblock(map)->nb_l) == libres;
+  close_fs(fd, map, size);
+  if (ok && cmd_fsck(fsname) == 0)
+    printf("[OK] écriture après la fin et trou percé sans allouer de blocs\n");
+  else
+    printf("[FAIL] fichier creux\n");
+  unlink(fsname);
+  unlink("creux_ext");
+}
+
+void TEST_GRANDE_TAILLE()
+{
+  printf("=== Test taille sur 64 bits ===\n");
+  const char *fsname = "test_taille64_fs";
+  unlink(fsname);
+  write_external_file("taille64_ext", "debut");
+  if (cmd_mkfs(fsname, 10, 100) != 0 || cmd_add(fsname, "taille64_ext", "gros") != 0)
+  {
+    printf("[FAIL] mkfs/add pour la taille sur 64 bits\n");
+    unlink(fsname);
+    unlink("taille64_ext");
+    return;
+  }
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int32_t libres = FROM_LE32(get_superblock(map)->nb_l);
+  struct inode *in = get_inode(map, find_inode_racine(map, nb1, nbi, "gros", false));
+  // Au-delà de 4 Go : passe par l'indirection triple (racine, double, simple et données)
+  char buf[8];
+  uint64_t off = 5000000000ULL;
+  int ok = file_use_blocks(map, in) == 0 && pfs_pwrite(map, in, "fin", 3, off) == 3 && inode_size(in) == off + 3;
+  ok = ok && (int32_t)FROM_LE32(in->triple_indirect_block) > 0;
+  ok = ok && pfs_pread(map, in, buf, 3, off) == 3 && memcmp(buf, "fin", 3) == 0;
+  ok = ok && (int32_t)FROM_LE32(get_superblock(map)->nb_l) == libres - 4;
+  close_fs(fd, map, size);
+  ok = ok && cmd_fsck(fsname) == 0;
+  // grep parcourt le fichier sans en charger la taille en mémoire
+  char out[64];
+  int saved = start_capture("taille64_grep");
+  ok = ok && cmd_grep(fsname, "fin") == 0;
+  end_capture(saved);
+  ok = ok && read_file_content("taille64_grep", out, sizeof(out)) >= 0 && strcmp(out, "/gros\n") == 0;
+  unlink("taille64_grep");
+  fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  in = get_inode(map, find_inode_racine(map, nb1, nbi, "gros", false));
+  // Le trou percé rend aussi les blocs d'adresses devenus vides
+  ok = ok && pfs_punch(map, in, off, 3) == 0 && (int32_t)FROM_LE32(in->triple_indirect_block) == 0;
+  ok = ok && (int32_t)FROM_LE32(get_superblock(map)->nb_l) == libres;
+  close_fs(fd, map, size);
+  if (ok && cmd_fsck(fsname) == 0)
+    printf("[OK] fichier de plus de 4 Go par indirection triple\n");
+  else
+    printf("[FAIL] taille sur 64 bits\n");
+  unlink(fsname);
+  unlink("taille64_ext");
+}
+
+void TEST_EXTENTS()
+{
+  printf("=== Test fichiers décrits par extents ===\n");
+  const char *fsname = "test_extents_fs";
+  unlink(fsname);
+  // 100 blocs écrits d'un coup : un seul extent
+  size_t len = 400000;
+  char *content = malloc(len + 1);
+  for (size_t k = 0; k < len; k++)
+    content[k] = 'a' + k / 4000 % 26;
+  content[len] = '\0';
+  write_external_file("extents_ext", content);
+  if (cmd_mkfs(fsname, 10, 2000) != 0 || cmd_add(fsname, "extents_ext", "suite") != 0)
+  {
+    printf("[FAIL] mkfs/add pour les extents\n");
+    unlink(fsname);
+    unlink("extents_ext");
+    free(content);
+    return;
+  }
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  struct inode *in = get_inode(map, find_inode_racine(map, nb1, nbi, "suite", false));
+  const struct extent *e = (const struct extent *)in->direct_blocks;
+  int ok = (FROM_LE32(in->flags) & INODE_EXTENTS) && (int32_t)FROM_LE32(e[0].length) == 100 &&
+           (int32_t)FROM_LE32(e[1].length) <= 0;
+  // Un trou au milieu coupe l'extent en deux
+  char buf[8];
+  ok = ok && pfs_punch(map, in, 50 * 4000, 4000) == 0 && (int32_t)FROM_LE32(e[1].length) == 49;
+  ok = ok && pfs_pread(map, in, buf, 2, 50 * 4000) == 2 && memcmp(buf, "\0\0", 2) == 0;
+  ok = ok && pfs_pread(map, in, buf, 2, 51 * 4000) == 2 && memcmp(buf, content + 51 * 4000, 2) == 0;
+  // Un bloc sur deux : chaque bloc est un extent, au-delà de INODE_EXTENTS_MAX on repasse aux blocs
+  for (int64_t k = 0; ok && k < INODE_EXTENTS_MAX + 50; k++)
+    ok = pfs_pwrite(map, in, "z", 1, (200 + 2 * k) * 4000) == 1;
+  ok = ok && !(FROM_LE32(in->flags) & INODE_EXTENTS);
+  ok = ok && pfs_pread(map, in, buf, 2, 51 * 4000) == 2 && memcmp(buf, content + 51 * 4000, 2) == 0;
+  ok = ok && pfs_pread(map, in, buf, 2, 400 * 4000) == 2 && memcmp(buf, "z\0", 2) == 0;
+  close_fs(fd, map, size);
+  if (ok && cmd_rm(fsname, "suite") == 0 && cmd_fsck(fsname) == 0)
+    printf("[OK] extents créés, coupés puis passage à l'adressage par blocs\n");
+  else
+    printf("[FAIL] fichiers décrits par extents\n");
+  unlink(fsname);
+  unlink("extents_ext");
+  free(content);
+}
+
+void TEST_SYNC()
+{
+  printf("=== Test des modes d'écriture à la fermeture ===\n");
+  const char *fsname = "test_sync_fs";
+  const enum sync_mode modes[] = {SYNC_ASYNC, SYNC_NONE, SYNC_FULL};
+  const char *names[] = {"async", "none", "sync"};
+  unlink(fsname);
+  write_external_file("sync_ext", "contenu");
+  int ok = cmd_mkfs(fsname, 10, 100) == 0;
+  for (int m = 0; ok && m < 3; m++)
+  {
+    // Les blocs modifiés restent visibles à la réouverture quel que soit le mode
+    set_sync_mode(modes[m]);
+    ok = cmd_add(fsname, "sync_ext", names[m]) == 0;
+    uint8_t *map;
+    size_t size;
+    int32_t nb1, nbi, nba, nbb;
+    char buf[8];
+    int fd = open_fs_ro(fsname, &map, &size, ACCESS_DEFAULT);
+    get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+    int32_t ino = find_inode_racine(map, nb1, nbi, names[m], false);
+    ok = ok && ino >= 0 && pfs_pread(map, get_inode(map, ino), buf, 7, 0) == 7 && memcmp(buf, "contenu", 7) == 0;
+    close_fs(fd, map, size);
+  }
+  set_sync_mode(SYNC_FULL);
+  if (ok && cmd_fsck(fsname) == 0)
+    printf("[OK] ajouts en modes async, none et sync relus\n");
+  else
+    printf("[FAIL] modes d'écriture à la fermeture\n");
+  unlink(fsname);
+  unlink("sync_ext");
+}
+
+void TEST_VERROUS()
+{
+  printf("=== Test des verrous de blocs entre processus ===\n");
+  const char *fsname = "test_verrous_fs";
+  unlink(fsname);
+  int ok = cmd_mkfs(fsname, 10, 100) == 0;
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int64_t offset = block_offset_of(map, get_inode(map, 1 + nb1));
+  int p[2];
+  ok = ok && pipe(p) == 0 && lock_block(fd, offset, F_WRLCK) == 0 && lock_block(fd, offset, F_WRLCK) == 0;
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    // Le fils attend que le parent rende le verrou de l'inode
+    uint8_t *cmap;
+    size_t csize;
+    int cfd = open_fs(fsname, &cmap, &csize, ACCESS_DEFAULT);
+    lock_block(cfd, offset, F_WRLCK);
+    write(p[1], "x", 1);
+    unlock_block(cfd, offset);
+    close_fs(cfd, cmap, csize);
+    _exit(0);
+  }
+  char c;
+  fcntl(p[0], F_SETFL, O_NONBLOCK);
+  usleep(200000);
+  bool waited = read(p[0], &c, 1) < 0; // Toujours bloqué
+  unlock_block(fd, offset);
+  fcntl(p[0], F_SETFL, 0);
+  ok = ok && pid > 0 && waited && read(p[0], &c, 1) == 1;
+  int status;
+  waitpid(pid, &status, 0);
+  close(p[0]);
+  close(p[1]);
+  close_fs(fd, map, size);
+  if (ok)
+    printf("[OK] verrou d'écriture attendu par un autre processus puis obtenu\n");
+  else
+    printf("[FAIL] verrous de blocs entre processus\n");
+  unlink(fsname);
+}
+
+void TEST_VERROU_LECTEUR_MORT()
+{
+  printf("=== Test d'un lecteur tué en tenant un verrou ===\n");
+  const char *fsname = "test_lecteur_mort_fs";
+  unlink(fsname);
+  int ok = cmd_mkfs(fsname, 10, 100) == 0;
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int64_t offset = block_offset_of(map, get_inode(map, 1 + nb1));
+  int p[2];
+  ok = ok && pipe(p) == 0;
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    // Le fils prend le verrou en lecture et meurt sans le rendre
+    uint8_t *cmap;
+    size_t csize;
+    int cfd = open_fs(fsname, &cmap, &csize, ACCESS_DEFAULT);
+    lock_block(cfd, offset, F_RDLCK);
+    write(p[1], "x", 1);
+    pause();
+    _exit(0);
+  }
+  char c;
+  ok = ok && pid > 0 && read(p[0], &c, 1) == 1;
+  kill(pid, SIGKILL);
+  int status;
+  waitpid(pid, &status, 0);
+  // Sans reprise du verrou du mort, l'écrivain attendrait indéfiniment
+  alarm(5);
+  ok = ok && lock_block(fd, offset, F_WRLCK) == 0;
+  alarm(0);
+  unlock_block(fd, offset);
+  close(p[0]);
+  close(p[1]);
+  close_fs(fd, map, size);
+  if (ok)
+    printf("[OK] verrou de lecture d'un processus tué repris par un écrivain\n");
+  else
+    printf("[FAIL] verrou de lecture d'un processus tué\n");
+  unlink(fsname);
+}
+
+void TEST_VERROU_PROMOTION()
+{
+  printf("=== Test du passage d'un verrou de lecture en écriture ===\n");
+  const char *fsname = "test_promotion_fs";
+  unlink(fsname);
+  int ok = cmd_mkfs(fsname, 10, 100) == 0;
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int64_t offset = block_offset_of(map, get_inode(map, 1 + nb1));
+  int p[2];
+  ok = ok && pipe(p) == 0 && lock_block(fd, offset, F_RDLCK) == 0;
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    // Le fils lit aussi le bloc, puis veut l'écrire : il attend que le parent le rende
+    uint8_t *cmap;
+    size_t csize;
+    int cfd = open_fs(fsname, &cmap, &csize, ACCESS_DEFAULT);
+    lock_block(cfd, offset, F_RDLCK);
+    write(p[1], "r", 1);
+    if (lock_block(cfd, offset, F_WRLCK) == 0)
+      write(p[1], "w", 1);
+    unlock_block(cfd, offset);
+    close_fs(cfd, cmap, csize);
+    _exit(0);
+  }
+  char c;
+  ok = ok && pid > 0 && read(p[0], &c, 1) == 1 && c == 'r';
+  usleep(100000);
+  // Les deux lecteurs veulent écrire : le second est refusé au lieu de s'interbloquer
+  ok = ok && lock_block(fd, offset, F_WRLCK) < 0 && errno == EDEADLK;
+  fcntl(p[0], F_SETFL, O_NONBLOCK);
+  bool waited = read(p[0], &c, 1) < 0;
+  unlock_block(fd, offset);
+  fcntl(p[0], F_SETFL, 0);
+  ok = ok && waited && read(p[0], &c, 1) == 1 && c == 'w';
+  int status;
+  waitpid(pid, &status, 0);
+  // Seul lecteur : le passage en écriture est immédiat et exclut un autre processus
+  ok = ok && lock_block(fd, offset, F_RDLCK) == 0 && lock_block(fd, offset, F_WRLCK) == 0;
+  pid = fork();
+  if (pid == 0)
+  {
+    uint8_t *cmap;
+    size_t csize;
+    int cfd = open_fs(fsname, &cmap, &csize, ACCESS_DEFAULT);
+    lock_block(cfd, offset, F_RDLCK);
+    write(p[1], "l", 1);
+    unlock_block(cfd, offset);
+    close_fs(cfd, cmap, csize);
+    _exit(0);
+  }
+  usleep(200000);
+  fcntl(p[0], F_SETFL, O_NONBLOCK);
+  waited = read(p[0], &c, 1) < 0;
+  unlock_block(fd, offset);
+  fcntl(p[0], F_SETFL, 0);
+  ok = ok && pid > 0 && waited && read(p[0], &c, 1) == 1;
+  waitpid(pid, &status, 0);
+  close(p[0]);
+  close(p[1]);
+  close_fs(fd, map, size);
+  if (ok)
+    printf("[OK] verrou de lecture passé en écriture, interblocage refusé\n");
+  else
+    printf("[FAIL] passage d'un verrou de lecture en écriture\n");
+  unlink(fsname);
+}
+
+void TEST_VERROUS_FCNTL()
+{
+  printf("=== Test de la table des verrous face à fcntl ===\n");
+  const char *fsname = "test_verrous_fcntl_fs";
+  unlink(fsname);
+  int ok = cmd_mkfs(fsname, 10, 100) == 0;
+  // Un processus qui verrouille ce conteneur avec fcntl (octet annoncé au-delà de la fin)
+  int other = open(fsname, O_RDONLY);
+  struct flock fl = {0};
+  fl.l_type = F_RDLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = (off_t)1 << 62;
+  fl.l_len = 1;
+  ok = ok && fcntl(other, F_OFD_SETLK, &fl) == 0;
+  uint8_t *map;
+  size_t size;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  ok = ok && fd >= 0 && !lock_table_covers(fd);
+  close_fs(fd, map, size);
+  close(other);
+  fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  ok = ok && fd >= 0 && lock_table_covers(fd);
+  close_fs(fd, map, size);
+  if (ok)
+    printf("[OK] fcntl utilisé par tous tant qu'un processus s'en sert\n");
+  else
+    printf("[FAIL] table des verrous face à fcntl\n");
+  unlink(fsname);
+}
+
+void TEST_VERROUS_DROITS()
+{
+  printf("=== Test des droits de la table des verrous ===\n");
+  const char *fsname = "test_verrous_droits_fs";
+  unlink(fsname);
+  int ok = cmd_mkfs(fsname, 10, 100) == 0 && chmod(fsname, 0640) == 0;
+  struct stat cst, sst;
+  char name[64];
+  ok = ok && stat(fsname, &cst) == 0;
+  snprintf(name, sizeof(name), "/pignoufs-%llx-%llx", (unsigned long long)cst.st_dev,
+           (unsigned long long)cst.st_ino);
+  // Le segment prend le propriétaire et les droits du conteneur, malgré le umask
+  mode_t old_mask = umask(077);
+  uint8_t *map;
+  size_t size;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  umask(old_mask);
+  ok = ok && fd >= 0 && lock_table_covers(fd);
+  int sfd = shm_open(name, O_RDONLY, 0);
+  ok = ok && sfd >= 0 && fstat(sfd, &sst) == 0 && (sst.st_mode & 0777) == 0640 &&
+       sst.st_uid == cst.st_uid && sst.st_gid == cst.st_gid;
+  if (sfd >= 0)
+    close(sfd);
+  close_fs(fd, map, size);
+  // Un segment ouvert à tous n'est pas rejoint : fcntl prend le relais
+  sfd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  ok = ok && sfd >= 0 && fchmod(sfd, 0666) == 0;
+  fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  ok = ok && fd >= 0 && !lock_table_covers(fd);
+  close_fs(fd, map, size);
+  if (sfd >= 0)
+    close(sfd);
+  shm_unlink(name);
+  if (ok)
+    printf("[OK] table des verrous aux droits du conteneur\n");
+  else
+    printf("[FAIL] droits de la table des verrous\n");
+  unlink(fsname);
+}
+
+void TEST_VERROUS_TABLE_PLEINE()
+{
+  printf("=== Test de la table des verrous pleine ===\n");
+  const char *fsname = "test_verrous_pleine_fs";
+  unlink(fsname);
+  int ok = cmd_mkfs(fsname, 10, 100) == 0;
+  struct stat cst;
+  char name[64];
+  ok = ok && stat(fsname, &cst) == 0;
+  snprintf(name, sizeof(name), "/pignoufs-%llx-%llx", (unsigned long long)cst.st_dev,
+           (unsigned long long)cst.st_ino);
+  int tube[2];
+  ok = ok && pipe(tube) == 0;
+  pid_t pid = ok ? fork() : -1;
+  if (pid == 0)
+  {
+    // Le fils ouvre la table puis prend tous les autres emplacements
+    uint8_t *map;
+    size_t size;
+    int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+    int sfd = shm_open(name, O_RDWR, 0);
+    struct flock fl = {0};
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_len = 1;
+    for (fl.l_start = 1; fl.l_start <= 30; fl.l_start++)
+      fcntl(sfd, F_OFD_SETLK, &fl);
+    char c = fd >= 0 && sfd >= 0 && lock_table_covers(fd);
+    if (write(tube[1], &c, 1) != 1)
+      _exit(1);
+    usleep(300000);
+    close_fs(fd, map, size);
+    _exit(0);
+  }
+  char c = 0;
+  ok = ok && pid > 0 && read(tube[0], &c, 1) == 1 && c;
+  // Pas d'emplacement : fcntl, une fois que le fils a fermé la table
+  uint8_t *map;
+  size_t size;
+  int fd = ok ? open_fs(fsname, &map, &size, ACCESS_DEFAULT) : -1;
+  ok = ok && fd >= 0 && !lock_table_covers(fd) && shm_open(name, O_RDONLY, 0) < 0 && errno == ENOENT;
+  if (fd >= 0)
+    close_fs(fd, map, size);
+  int status;
+  ok = ok && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (ok)
+    printf("[OK] table pleine : fcntl une fois la table fermée\n");
+  else
+    printf("[FAIL] table des verrous pleine\n");
+  close(tube[0]);
+  close(tube[1]);
+  unlink(fsname);
+}
+
+void TEST_SHA1_DEVERROUILLAGE()
+{
+  printf("=== Test des SHA1 écrits avant de rendre un verrou ===\n");
+  const char *fsname = "test_deverrou_fs";
+  unlink(fsname);
+  write_external_file("deverrou_ext", "contenu");
+  int ok = cmd_mkfs(fsname, 10, 100) == 0 && cmd_add(fsname, "deverrou_ext", "f") == 0;
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int32_t ino = find_inode_racine(map, nb1, nbi, "f", false);
+  ok = ok && ino >= 0;
+  if (ok)
+  {
+    // Écriture sous le verrou de l'inode : une fois le verrou rendu, un autre processus
+    // doit trouver tous les blocs avec leur SHA1, sans attendre la fermeture
+    struct inode *in = get_inode(map, ino);
+    int64_t offset = block_offset_of(map, in);
+    ok = lock_block(fd, offset, F_WRLCK) == 0 && pfs_pwrite(map, in, "nouveau contenu", 15, 4) == 15;
+    unlock_block(fd, offset);
+    uint8_t sha[20];
+    for (int32_t b = 0; ok && b < nbb; b++)
+    {
+      calcul_sha1(map + (int64_t)b * 4096, 4000, sha);
+      ok = memcmp(sha, map + (int64_t)b * 4096 + 4000, 20) == 0;
+    }
+  }
+  close_fs(fd, map, size);
+  if (ok)
+    printf("[OK] SHA1 à jour dès que le verrou est rendu\n");
+  else
+    printf("[FAIL] SHA1 écrits avant de rendre un verrou\n");
+  unlink(fsname);
+  unlink("deverrou_ext");
+}
+
+void TEST_ANCIEN_FORMAT()
+{
+  printf("=== Test de lecture seule d'un ancien conteneur ===\n");
+  const char *fsname = "test_ancien_fs";
+  unlink(fsname);
+  write_external_file("ancien_ext", "contenu");
+  int ok = cmd_mkfs(fsname, 10, 100) == 0 && cmd_mkdir(fsname, "d") == 0 &&
+           cmd_add(fsname, "ancien_ext", "d/f") == 0;
+  // Conteneur d'avant les parents et les tailles 64 bits : zone d'extensions non nulle
+  uint8_t *map;
+  size_t size;
+  int32_t nb1, nbi, nba, nbb;
+  int fd = open_fs(fsname, &map, &size, ACCESS_DEFAULT);
+  get_conteneur_data(map, &nb1, &nbi, &nba, &nbb);
+  int32_t d = find_inode_racine(map, nb1, nbi, "d", true);
+  int32_t f = d >= 0 ? find_file_folder_from_inode(map, get_inode(map, d), "f", false) : -1;
+  ok = ok && f >= 0;
+  if (ok)
+  {
+    struct inode *in = get_inode(map, f);
+    in->parent = TO_LE32(0);
+    in->file_size_hi = TO_LE32(7);
+    in->triple_indirect_block = TO_LE32(5);
+    update_block_sha1(in);
+    struct pignoufs *sb = get_superblock(map);
+    sb->features = TO_LE32(PFS_FEATURE_ROOT);
+    update_block_sha1(sb);
+  }
+  close_fs(fd, map, size);
+  // Lecture seule : rien n'est réécrit, les champs d'extension sont ignorés
+  char buf[8], path[64];
+  fd = open_fs_ro(fsname, &map, &size, ACCESS_DEFAULT);
+  if (ok)
+  {
+    struct inode *in = get_inode(map, f);
+    inode_path(map, f, path, sizeof(path));
+    ok = FROM_LE32(get_superblock(map)->features) == PFS_FEATURE_ROOT && inode_size(in) == 7 &&
+         pfs_pread(map, in, buf, 7, 0) == 7 && memcmp(buf, "contenu", 7) == 0 && strcmp(path, "/d/f") == 0;
+  }
+  close_fs(fd, map, size);
+  // Une commande qui écrit met le conteneur à niveau
+  ok = ok && cmd_fsck(fsname) == 0;
+  fd = open_fs_ro(fsname, &map, &size, ACCESS_DEFAULT);
+  ok = ok && (FROM_LE32(get_superblock(map)->features) & PFS_FEATURE_SIZE64) && inode_size(get_inode(map, f)) == 7;
+  close_fs(fd, map, size);
+  if (ok)
+    printf("[OK] ancien conteneur lu sans mise à niveau, puis mis à niveau par fsck\n");
+  else
+    printf("[FAIL] lecture seule d'un ancien conteneur\n");
+  unlink(fsname);
+  unlink("ancien_ext");
+}
+
 int main()
 {
   TEST_MKFS();
@@ -965,6 +1925,8 @@ int main()
   printf("\n");
   TEST_INPUT();
   printf("\n");
+  TEST_INPUT_TUBE();
+  printf("\n");
   TEST_ADDINPUT();
   printf("\n");
   TEST_LS();
@@ -983,8 +1945,48 @@ int main()
   printf("\n");
   TEST_MV_DIR();
   printf("\n");
+  TEST_CACHE_DEPLACEMENT();
+  printf("\n");
   TEST_RM();
   printf("\n");
+  TEST_FSCK();
+  printf("\n");
+  TEST_SHA1();
+  printf("\n");
+  TEST_DIR_INDEX();
+  printf("\n");
+  TEST_GRAND_DOSSIER();
+  printf("\n");
+  TEST_INDEX_RECONSTRUIT();
+  printf("\n");
+  TEST_GRAND_FICHIER();
+  printf("\n");
+  TEST_READ_WRITE();
+  printf("\n");
+  TEST_FICHIER_CREUX();
+  printf("\n");
+  TEST_GRANDE_TAILLE();
+  printf("\n");
+  TEST_EXTENTS();
+  printf("\n");
+  TEST_SYNC();
+  printf("\n");
+  TEST_VERROUS();
+  printf("\n");
+  TEST_VERROU_LECTEUR_MORT();
+  printf("\n");
+  TEST_VERROU_PROMOTION();
+  printf("\n");
+  TEST_VERROUS_FCNTL();
+  printf("\n");
+  TEST_VERROUS_DROITS();
+  printf("\n");
+  TEST_VERROUS_TABLE_PLEINE();
+  printf("\n");
+  TEST_SHA1_DEVERROUILLAGE();
+  printf("\n");
+  TEST_ANCIEN_FORMAT();
+  printf("\n");
 
   return 0;
 }
\ No newline at end of file